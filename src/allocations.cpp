@@ -0,0 +1,89 @@
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+#include "allocations.hpp"
+
+namespace Allocations {
+#ifdef PONGON_DEBUG_
+	static thread_local sf::Uint64 count;
+
+	static void* Allocate(std::size_t size) noexcept;
+#endif
+}
+
+
+sf::Uint64 Allocations::Count()
+{
+#ifdef PONGON_DEBUG_
+	return count;
+#else
+	return 0;
+#endif
+}
+
+void Allocations::AssertNone(const sf::Uint64 since)
+{
+	assert(Count() == since);
+	static_cast<void>(since);
+}
+
+#ifdef PONGON_DEBUG_
+void* Allocations::Allocate(const std::size_t size) noexcept
+{
+	++count;
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new(const std::size_t size)
+{
+	if (void* const ptr = Allocations::Allocate(size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](const std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocations::Allocate(size);
+}
+
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocations::Allocate(size);
+}
+
+void operator delete(void* const ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* const ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* const ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* const ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* const ptr, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* const ptr, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+#endif
@@ -0,0 +1,15 @@
+#ifndef PONGON_ALLOCATIONS_HPP_
+#define PONGON_ALLOCATIONS_HPP_
+#include <SFML/System.hpp>
+
+// debug builds replace the global operator new to count the allocations
+// each thread makes, so the frame and tick paths can be checked to make
+// none. the stdin and network threads keep counts of their own
+namespace Allocations {
+	// the calling thread's allocations so far, always 0 unless PONGON_DEBUG_
+	sf::Uint64 Count();
+	// asserts the calling thread allocated nothing since Count gave since
+	void AssertNone(sf::Uint64 since);
+}
+
+#endif
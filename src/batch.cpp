@@ -0,0 +1,519 @@
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "batch.hpp"
+#include "physics.hpp"
+
+// the vector kernels are written once with gcc's vector extensions, which
+// clang has as well: a vector of 4 floats is sse, always there on x86-64,
+// one of 8 is avx2 inside a function built for it
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(PONGON_FIXED_POINT_)
+#define PONGON_BATCH_SIMD_
+#define PONGON_ALWAYS_INLINE_ inline __attribute__((always_inline))
+#include <immintrin.h>
+#endif
+
+#if defined(PONGON_BATCH_SIMD_) && !defined(__clang__)
+// the helpers taking and returning 8 floats are always inlined, the abi
+// gcc warns about passing them in without avx is never used
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace Batch {
+	static std::size_t Padded(int count);
+	static void StepScalar(Matches* matches);
+	static bool Same(const GameState& first, const GameState& second);
+
+#ifdef PONGON_BATCH_SIMD_
+	using Floats4 = float __attribute__((vector_size(16)));
+	using Floats8 = float __attribute__((vector_size(32)));
+	// a comparison's result, every bit of a lane set where it holds
+	template<class V>
+	using Mask = decltype(V {} < V {});
+
+	// Physics::Contact for a vector of balls, the surface as an int
+	template<class V>
+	struct Contacts {
+		V time;
+		Mask<V> surface;
+		V normal_x, normal_y;
+	};
+
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ V Load(const std::vector<float>& array, std::size_t index);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ void Store(const V& v, std::size_t index, std::vector<float>* array);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ V Splat(float value);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ V Abs(const V& v);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ V Max(const V& a, const V& b);
+	static PONGON_ALWAYS_INLINE_ Floats4 Sqrt(const Floats4& v);
+	static PONGON_ALWAYS_INLINE_ Floats8 Sqrt(const Floats8& v);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ bool Any(const Mask<V>& mask);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ void Touch(const V& time, Physics::Surface surface, const Mask<V>& valid, Contacts<V>* contact);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ Mask<V> Closing(const V& d, const V& v);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ void SweepWalls(const Physics::State<V>& s, Contacts<V>* contact);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ void SweepPaddle(const Physics::State<V>& s, const V& x, const V& y, Contacts<V>* contact);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ V Clamp(const V& y, const V& velocity);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ void StepLanes(const V& dt, Physics::State<V>* state);
+	template<class V>
+	static PONGON_ALWAYS_INLINE_ void StepVectors(Matches* matches);
+	static void StepSse(Matches* matches);
+	__attribute__((target("avx2"))) static void StepAvx2(Matches* matches);
+#endif
+}
+
+
+void Batch::Init(const int count, const GameState& state, Matches* const matches)
+{
+	const auto size = Padded(count);
+	auto& m = *matches;
+	m.count = count;
+	m.frame = state.frame;
+	for (auto array : {&m.ball_x, &m.ball_y, &m.ball_velocity_x, &m.ball_velocity_y,
+	                   &m.local_x, &m.local_y, &m.local_velocity,
+	                   &m.remote_x, &m.remote_y, &m.remote_velocity})
+		array->resize(size);
+	for (std::size_t i = 0; i < size; ++i)
+		Set(static_cast<int>(i), state, matches);
+}
+
+void Batch::Set(const int index, const GameState& state, Matches* const matches)
+{
+	const auto i = static_cast<std::size_t>(index);
+	auto& m = *matches;
+	m.ball_x[i] = state.ball.x;
+	m.ball_y[i] = state.ball.y;
+	m.ball_velocity_x[i] = state.ball_velocity.x;
+	m.ball_velocity_y[i] = state.ball_velocity.y;
+	m.local_x[i] = state.local.x;
+	m.local_y[i] = state.local.y;
+	m.local_velocity[i] = state.local.velocity;
+	m.remote_x[i] = state.remote.x;
+	m.remote_y[i] = state.remote.y;
+	m.remote_velocity[i] = state.remote.velocity;
+}
+
+GameState Batch::Get(const Matches& matches, const int index)
+{
+	const auto i = static_cast<std::size_t>(index);
+	const auto& m = matches;
+	GameState state;
+	state.frame = m.frame;
+	state.ball = {m.ball_x[i], m.ball_y[i]};
+	state.ball_velocity = {m.ball_velocity_x[i], m.ball_velocity_y[i]};
+	state.local = {m.local_x[i], m.local_y[i], m.local_velocity[i]};
+	state.remote = {m.remote_x[i], m.remote_y[i], m.remote_velocity[i]};
+	return state;
+}
+
+bool Batch::Supported(const Kernel kernel)
+{
+#ifdef PONGON_BATCH_SIMD_
+	if (kernel == Kernel::Avx2)
+		return __builtin_cpu_supports("avx2");
+	return true;
+#else
+	return kernel == Kernel::Scalar;
+#endif
+}
+
+Batch::Kernel Batch::Best()
+{
+	for (const auto kernel : {Kernel::Avx2, Kernel::Sse}) {
+		if (Supported(kernel))
+			return kernel;
+	}
+	return Kernel::Scalar;
+}
+
+const char* Batch::Name(const Kernel kernel)
+{
+	switch (kernel) {
+	case Kernel::Sse: return "sse";
+	case Kernel::Avx2: return "avx2";
+	default: return "scalar";
+	}
+}
+
+void Batch::Step(const Kernel kernel, Matches* const matches)
+{
+#ifdef PONGON_BATCH_SIMD_
+	if (kernel == Kernel::Avx2 && Supported(kernel))
+		StepAvx2(matches);
+	else if (kernel == Kernel::Sse)
+		StepSse(matches);
+	else
+		StepScalar(matches);
+#else
+	static_cast<void>(kernel);
+	StepScalar(matches);
+#endif
+	++matches->frame;
+}
+
+bool Batch::Run(const int matches, const int frames)
+{
+	if (matches < 1 || frames < 1) {
+		std::cerr << "batch matches and frames must be 1 or more\n";
+		return false;
+	}
+
+	// balls anywhere between the paddles, 1 to 16 times as fast as the
+	// game's, heading anywhere but straight up or down
+	std::mt19937 generator {1};
+	std::uniform_real_distribution<float> ball_x {kWinWidth / 4.f, kWinWidth * 3.f / 4.f};
+	std::uniform_real_distribution<float> ball_y {kBallRadius, kWinHeight - kBallRadius};
+	std::uniform_real_distribution<float> paddle_y {kPaddleHeight / 2.f, kWinHeight - kPaddleHeight / 2.f};
+	std::uniform_real_distribution<float> speed {kBallVelocity, kBallVelocity * 16.f};
+	std::uniform_real_distribution<float> angle {-1.f, 1.f};
+	std::vector<GameState> starts(static_cast<std::size_t>(matches));
+	for (auto& start : starts) {
+		start = initial_state(true);
+		start.ball = {to_scalar(ball_x(generator)), to_scalar(ball_y(generator))};
+		const auto ball_speed = speed(generator);
+		const auto ball_angle = angle(generator);
+		const auto direction = generator() % 2 == 0 ? 1.f : -1.f;
+		start.ball_velocity = {to_scalar(direction * ball_speed * std::cos(ball_angle)),
+		                       to_scalar(ball_speed * std::sin(ball_angle))};
+		start.local.y = to_scalar(paddle_y(generator));
+		start.remote.y = to_scalar(paddle_y(generator));
+	}
+
+	// inputs looked up from a table, so both ways pay the same for them
+	constexpr const std::size_t kInputs {4096};
+	const float velocities[3] {-kPaddleVelocity, 0.f, kPaddleVelocity};
+	std::vector<float> inputs(kInputs);
+	for (auto& input : inputs)
+		input = velocities[generator() % 3];
+	const auto input = [&inputs](const int match, const int frame, const int side) {
+		return inputs[(static_cast<std::size_t>(match) * 31 + static_cast<std::size_t>(frame) * 7 + side) % kInputs];
+	};
+
+	using Clock = std::chrono::steady_clock;
+	const auto per_frame = [matches, frames](const Clock::time_point start) {
+		const std::chrono::duration<double, std::nano> elapsed {Clock::now() - start};
+		return elapsed.count() / (static_cast<double>(matches) * frames);
+	};
+
+	std::cout << "batch benchmark, " << matches << " matches for " << frames << " frames, "
+	          << (Physics::Number<Physics::Scalar>::kTag == 0 ? "floats" : "fixed point") << '\n';
+
+	auto states = starts;
+	auto start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		for (int i = 0; i < matches; ++i)
+			step({input(i, frame, 0), input(i, frame, 1)}, &states[static_cast<std::size_t>(i)]);
+	}
+	std::cout << "step one by one: " << per_frame(start) << " ns per match frame\n";
+
+	bool same {true};
+	Matches batch;
+	for (const auto kernel : {Kernel::Scalar, Kernel::Sse, Kernel::Avx2}) {
+		if (!Supported(kernel))
+			continue;
+
+		Init(matches, starts.front(), &batch);
+		for (int i = 0; i < matches; ++i)
+			Set(i, starts[static_cast<std::size_t>(i)], &batch);
+		start = Clock::now();
+		for (int frame = 0; frame < frames; ++frame) {
+			for (int i = 0; i < matches; ++i) {
+				batch.local_velocity[static_cast<std::size_t>(i)] = to_scalar(input(i, frame, 0));
+				batch.remote_velocity[static_cast<std::size_t>(i)] = to_scalar(input(i, frame, 1));
+			}
+			Step(kernel, &batch);
+		}
+		const auto nanoseconds = per_frame(start);
+
+		int differ {0};
+		for (int i = 0; i < matches; ++i)
+			differ += !Same(Get(batch, i), states[static_cast<std::size_t>(i)]);
+		std::cout << Name(kernel) << " kernel: " << nanoseconds << " ns per match frame, "
+		          << differ << " matches ended elsewhere than with step\n";
+		same = same && differ == 0;
+	}
+	return same;
+}
+
+std::size_t Batch::Padded(const int count)
+{
+	return static_cast<std::size_t>((count + kLanes - 1) / kLanes * kLanes);
+}
+
+// step itself, match by match
+void Batch::StepScalar(Matches* const matches)
+{
+	for (int i = 0; i < matches->count; ++i) {
+		auto state = Get(*matches, i);
+		step({to_float(state.local.velocity), to_float(state.remote.velocity)}, &state);
+		Set(i, state, matches);
+	}
+}
+
+// every number, a fixed point state has padding memcmp would look at
+bool Batch::Same(const GameState& first, const GameState& second)
+{
+	const auto same_paddle = [](const PaddleState& a, const PaddleState& b) {
+		return a.x == b.x && a.y == b.y && a.velocity == b.velocity;
+	};
+	return first.frame == second.frame &&
+	       first.ball.x == second.ball.x && first.ball.y == second.ball.y &&
+	       first.ball_velocity.x == second.ball_velocity.x && first.ball_velocity.y == second.ball_velocity.y &&
+	       same_paddle(first.local, second.local) && same_paddle(first.remote, second.remote);
+}
+
+#ifdef PONGON_BATCH_SIMD_
+
+// what follows is Physics::Step over vectors, each comparison a mask
+// picking between both sides of the branch it was. the operations and
+// their order are the same, so are the results
+
+template<class V>
+V Batch::Load(const std::vector<float>& array, const std::size_t index)
+{
+	V v;
+	std::memcpy(&v, &array[index], sizeof(v));
+	return v;
+}
+
+template<class V>
+void Batch::Store(const V& v, const std::size_t index, std::vector<float>* const array)
+{
+	std::memcpy(&(*array)[index], &v, sizeof(v));
+}
+
+template<class V>
+V Batch::Splat(const float value)
+{
+	V v;
+	for (std::size_t i = 0; i < sizeof(V) / sizeof(float); ++i)
+		v[i] = value;
+	return v;
+}
+
+template<class V>
+V Batch::Abs(const V& v)
+{
+	Mask<V> bits;
+	std::memcpy(&bits, &v, sizeof(bits));
+	bits &= 0x7fffffff;
+	V result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+// as std::max: b only where a < b
+template<class V>
+V Batch::Max(const V& a, const V& b)
+{
+	return a < b ? b : a;
+}
+
+Batch::Floats4 Batch::Sqrt(const Floats4& v)
+{
+	return _mm_sqrt_ps(v);
+}
+
+// in halves, a function that isn't built for avx can't use it even when
+// it ends up inlined into one that is
+Batch::Floats8 Batch::Sqrt(const Floats8& v)
+{
+	Floats4 halves[2];
+	std::memcpy(halves, &v, sizeof(halves));
+	halves[0] = Sqrt(halves[0]);
+	halves[1] = Sqrt(halves[1]);
+	Floats8 result;
+	std::memcpy(&result, halves, sizeof(result));
+	return result;
+}
+
+template<class V>
+bool Batch::Any(const Mask<V>& mask)
+{
+	int any {0};
+	for (std::size_t i = 0; i < sizeof(V) / sizeof(float); ++i)
+		any |= mask[i];
+	return any != 0;
+}
+
+template<class V>
+void Batch::Touch(const V& time, const Physics::Surface surface, const Mask<V>& valid, Contacts<V>* const contact)
+{
+	const auto touched = valid & (time < contact->time);
+	contact->time = touched ? time : contact->time;
+	contact->surface = touched ? Mask<V> {} + static_cast<int>(surface) : contact->surface;
+}
+
+template<class V>
+Batch::Mask<V> Batch::Closing(const V& d, const V& v)
+{
+	const V zero {};
+	return ((d < zero) & (v > zero)) | ((d > zero) & (v < zero));
+}
+
+template<class V>
+void Batch::SweepWalls(const Physics::State<V>& s, Contacts<V>* const contact)
+{
+	constexpr const float width {kWinWidth};
+	constexpr const float height {kWinHeight};
+	constexpr const float r {kBallRadius / 2.f};
+	const V zero {};
+	const auto vx = s.ball_velocity_x;
+	const auto vy = s.ball_velocity_y;
+
+	const V wall_x {vx < zero ? r - s.ball_x : width - r - s.ball_x};
+	Touch(Max(zero, wall_x / vx), Physics::Surface::X, vx != zero, contact);
+	const V wall_y {vy < zero ? r - s.ball_y : height - r - s.ball_y};
+	Touch(Max(zero, wall_y / vy), Physics::Surface::Y, vy != zero, contact);
+}
+
+template<class V>
+void Batch::SweepPaddle(const Physics::State<V>& s, const V& x, const V& y, Contacts<V>* const contact)
+{
+	constexpr const float half_width {kPaddleWidth / 2.f};
+	constexpr const float half_height {kPaddleHeight / 2.f};
+	constexpr const float r {kBallRadius / 2.f};
+	const V zero {};
+	const auto vx = s.ball_velocity_x;
+	const auto vy = s.ball_velocity_y;
+	const V dx {s.ball_x - x};
+	const V dy {s.ball_y - y};
+
+	const auto time = contact->time;
+	const auto far = (Abs(dx) - Abs(vx) * time > half_width + r) | (Abs(dy) - Abs(vy) * time > half_height + r);
+	const auto outside_x = Max(zero, Abs(dx) - half_width);
+	const auto outside_y = Max(zero, Abs(dy) - half_height);
+	const auto inside = outside_x * outside_x + outside_y * outside_y < r * r;
+	const auto reached = ~far & ~inside;
+	if (!Any<V>(reached))
+		return;
+
+	const V face_x {dx < zero ? Splat<V>(-(half_width + r)) : Splat<V>(half_width + r)};
+	const V hit_x {(face_x - dx) / vx};
+	Touch(hit_x, Physics::Surface::X,
+	      reached & Closing(dx, vx) & (hit_x >= zero) & (Abs(dy + vy * hit_x) <= half_height), contact);
+	const V face_y {dy < zero ? Splat<V>(-(half_height + r)) : Splat<V>(half_height + r)};
+	const V hit_y {(face_y - dy) / vy};
+	Touch(hit_y, Physics::Surface::Y,
+	      reached & Closing(dy, vy) & (hit_y >= zero) & (Abs(dx + vx * hit_y) <= half_width), contact);
+
+	const V a {vx * vx + vy * vy};
+	for (const auto corner_x : {-half_width, half_width}) {
+		for (const auto corner_y : {-half_height, half_height}) {
+			const V ox {dx - corner_x};
+			const V oy {dy - corner_y};
+			const V b {ox * vx + oy * vy};
+			const V discriminant {b * b - a * (ox * ox + oy * oy - r * r)};
+			const V hit {(-b - Sqrt(discriminant)) / a};
+			const auto touched = reached & ~(b >= zero) & ~(discriminant < zero)
+			                   & ~((hit < zero) | (hit >= contact->time))
+			                   & (Abs(dx + vx * hit) > half_width) & (Abs(dy + vy * hit) > half_height);
+			contact->time = touched ? hit : contact->time;
+			contact->surface = touched ? Mask<V> {} + static_cast<int>(Physics::Surface::Corner) : contact->surface;
+			contact->normal_x = touched ? ox + vx * hit : contact->normal_x;
+			contact->normal_y = touched ? oy + vy * hit : contact->normal_y;
+		}
+	}
+}
+
+template<class V>
+V Batch::Clamp(const V& y, const V& velocity)
+{
+	constexpr const float height {kWinHeight};
+	constexpr const float half_height {kPaddleHeight / 2.f};
+	const V zero {};
+	const auto stopped = ((velocity < zero) & (y - half_height <= zero))
+	                   | ((velocity > zero) & (y + half_height >= height));
+	return stopped ? zero : velocity;
+}
+
+// the bounces stop once no lane has any of the frame left, a lane that
+// has none keeps its ball where it is
+template<class V>
+void Batch::StepLanes(const V& dt, Physics::State<V>* const state)
+{
+	const V zero {};
+	auto& s = *state;
+
+	s.local_velocity = Clamp(s.local_y, s.local_velocity);
+	s.remote_velocity = Clamp(s.remote_y, s.remote_velocity);
+
+	auto left = dt;
+	for (int bounces = 0; bounces < Physics::kMaxBounces; ++bounces) {
+		const auto moving = left > zero;
+		if (!Any<V>(moving))
+			break;
+
+		Contacts<V> contact {left, Mask<V> {}, zero, zero};
+		SweepWalls(s, &contact);
+		SweepPaddle(s, s.local_x, s.local_y, &contact);
+		SweepPaddle(s, s.remote_x, s.remote_y, &contact);
+		s.ball_x = moving ? s.ball_x + s.ball_velocity_x * contact.time : s.ball_x;
+		s.ball_y = moving ? s.ball_y + s.ball_velocity_y * contact.time : s.ball_y;
+		left = moving ? left - contact.time : left;
+
+		const auto surface = contact.surface;
+		const auto flip_x = moving & (surface == static_cast<int>(Physics::Surface::X));
+		const auto flip_y = moving & (surface == static_cast<int>(Physics::Surface::Y));
+		const auto corner = moving & (surface == static_cast<int>(Physics::Surface::Corner));
+		const auto nx = contact.normal_x;
+		const auto ny = contact.normal_y;
+		const V along {(s.ball_velocity_x * nx + s.ball_velocity_y * ny) / (nx * nx + ny * ny)};
+		s.ball_velocity_x = flip_x ? -s.ball_velocity_x : s.ball_velocity_x;
+		s.ball_velocity_y = flip_y ? -s.ball_velocity_y : s.ball_velocity_y;
+		s.ball_velocity_x = corner ? s.ball_velocity_x - (along + along) * nx : s.ball_velocity_x;
+		s.ball_velocity_y = corner ? s.ball_velocity_y - (along + along) * ny : s.ball_velocity_y;
+	}
+
+	s.local_y = s.local_velocity != zero ? s.local_y + s.local_velocity * dt : s.local_y;
+	s.remote_y = s.remote_velocity != zero ? s.remote_y + s.remote_velocity * dt : s.remote_y;
+}
+
+template<class V>
+void Batch::StepVectors(Matches* const matches)
+{
+	auto& m = *matches;
+	const auto dt = Splat<V>(tick_length());
+	for (std::size_t i = 0; i < m.ball_x.size(); i += sizeof(V) / sizeof(float)) {
+		Physics::State<V> s {
+			Load<V>(m.ball_x, i), Load<V>(m.ball_y, i),
+			Load<V>(m.ball_velocity_x, i), Load<V>(m.ball_velocity_y, i),
+			Load<V>(m.local_x, i), Load<V>(m.local_y, i), Load<V>(m.local_velocity, i),
+			Load<V>(m.remote_x, i), Load<V>(m.remote_y, i), Load<V>(m.remote_velocity, i)
+		};
+		StepLanes(dt, &s);
+		Store(s.ball_x, i, &m.ball_x);
+		Store(s.ball_y, i, &m.ball_y);
+		Store(s.ball_velocity_x, i, &m.ball_velocity_x);
+		Store(s.ball_velocity_y, i, &m.ball_velocity_y);
+		Store(s.local_y, i, &m.local_y);
+		Store(s.local_velocity, i, &m.local_velocity);
+		Store(s.remote_y, i, &m.remote_y);
+		Store(s.remote_velocity, i, &m.remote_velocity);
+	}
+}
+
+void Batch::StepSse(Matches* const matches)
+{
+	StepVectors<Floats4>(matches);
+}
+
+void Batch::StepAvx2(Matches* const matches)
+{
+	StepVectors<Floats8>(matches);
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef PONGON_BATCH_HPP_
+#define PONGON_BATCH_HPP_
+#include <cstdint>
+#include <vector>
+
+#include "simulation.hpp"
+
+// many matches stepped together, for servers and bots playing thousands
+// at once. each number of a GameState is kept in an array of its own,
+// match i at index i, so the ball x of kLanes matches loads as one vector
+// and a kernel steps them all with the same instructions, Physics::Step's
+// branches turned into masks. the sse and avx2 kernels do the same float
+// operations in the same order as step, so every match ends bit for bit
+// where step would have left it. they are picked at runtime by what the
+// cpu supports, on x86-64 with gcc or clang. fixed point builds and other
+// targets only have the scalar kernel, Physics::Step run match by match
+namespace Batch {
+	// the arrays are padded to a multiple of it, the padding stepped along
+	constexpr const int kLanes {8};
+
+	enum class Kernel {Scalar, Sse, Avx2};
+
+	// the paddle velocities are the inputs the next step runs with, it
+	// clamps them and leaves them there like step does
+	struct Matches {
+		int count;
+		std::int32_t frame;
+		std::vector<Scalar> ball_x, ball_y;
+		std::vector<Scalar> ball_velocity_x, ball_velocity_y;
+		std::vector<Scalar> local_x, local_y, local_velocity;
+		std::vector<Scalar> remote_x, remote_y, remote_velocity;
+	};
+
+	// count matches all starting from state
+	void Init(int count, const GameState& state, Matches* matches);
+	// the frame is the batch's, not the state's
+	void Set(int index, const GameState& state, Matches* matches);
+	GameState Get(const Matches& matches, int index);
+	bool Supported(Kernel kernel);
+	// the widest kernel this cpu runs
+	Kernel Best();
+	const char* Name(Kernel kernel);
+	// an unsupported kernel runs as the scalar one
+	void Step(Kernel kernel, Matches* matches);
+	// steps matches random matches for frames frames with each kernel
+	// supported and with step one by one, prints how long a match's frame
+	// took with each and checks they all ended the same
+	bool Run(int matches, int frames);
+}
+
+#endif
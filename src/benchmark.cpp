@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "physics.hpp"
+
+namespace Benchmark {
+	using T = Physics::Scalar;
+	using Number = Physics::Number<T>;
+	using State = Physics::State<T>;
+	using Step = void (*)(State*);
+
+	struct Result {
+		double nanoseconds;
+		int through;
+		int inside;
+	};
+
+	static void Discrete(State* state);
+	static void Swept(State* state);
+	static State Start(float speed);
+	static T Follow(const State& state, T y, T speed);
+	static bool Inside(const State& state, T x, T y);
+	static bool Through(const State& before, const State& after, T x, T y);
+	static Result Measure(Step step, float speed, const std::vector<sf::Uint8>& inputs);
+}
+
+
+bool Benchmark::Run(const int frames)
+{
+	if (frames < 1) {
+		std::cerr << "benchmark frames must be 1 or more\n";
+		return false;
+	}
+
+	// the same inputs for both, so the time isn't the generator's
+	std::mt19937 generator {1};
+	std::vector<sf::Uint8> inputs(static_cast<std::size_t>(frames));
+	for (auto& input : inputs)
+		input = static_cast<sf::Uint8>(generator() % 9);
+
+	std::cout << "collision benchmark, " << frames << " frames per run, "
+	          << (Number::kTag == 0 ? "floats" : "fixed point")
+	          << ", ball speed in multiples of " << kBallVelocity << " pixels a frame\n";
+	for (const auto speed : kSpeeds) {
+		const auto discrete = Measure(Discrete, speed, inputs);
+		const auto swept = Measure(Swept, speed, inputs);
+		std::cout << "speed " << speed << "x: discrete " << discrete.nanoseconds << " ns/frame, "
+		          << discrete.through << " through a paddle, " << discrete.inside << " frames inside one; "
+		          << "swept " << swept.nanoseconds << " ns/frame, "
+		          << swept.through << " through, " << swept.inside << " inside\n";
+	}
+	return true;
+}
+
+// what the frame step did before the sweep: the ball
+// flips on any overlap with a paddle, and on leaving the screen
+void Benchmark::Discrete(State* const state)
+{
+	using std::abs;
+	constexpr const T zero {Number::FromFloat(0.f)};
+	constexpr const T width {Number::FromFloat(kWinWidth)};
+	constexpr const T height {Number::FromFloat(kWinHeight)};
+	constexpr const T ball_half {Number::FromFloat(kBallRadius / 2.f)};
+	constexpr const T half_width {Number::FromFloat(kPaddleWidth / 2.f)};
+	constexpr const T half_height {Number::FromFloat(kPaddleHeight / 2.f)};
+	auto& s = *state;
+
+	const auto collided = [&](const T x, const T y) {
+		return (s.ball_x + ball_half >= x - half_width && s.ball_x - ball_half <= x + half_width)
+		&& (s.ball_y + ball_half >= y - half_height && s.ball_y - ball_half <= y + half_height);
+	};
+
+	if (collided(s.local_x, s.local_y) || collided(s.remote_x, s.remote_y)) {
+		s.ball_velocity_x = -s.ball_velocity_x;
+	} else {
+		if (s.ball_x - ball_half < zero)
+			s.ball_velocity_x = abs(s.ball_velocity_x);
+		else if (s.ball_x + ball_half > width)
+			s.ball_velocity_x = -abs(s.ball_velocity_x);
+		if (s.ball_y - ball_half < zero)
+			s.ball_velocity_y = abs(s.ball_velocity_y);
+		else if (s.ball_y + ball_half > height)
+			s.ball_velocity_y = -abs(s.ball_velocity_y);
+	}
+
+	const auto clamp = [&](const T y, T& velocity) {
+		if (velocity < zero && y - half_height <= zero)
+			velocity = zero;
+		else if (velocity > zero && y + half_height >= height)
+			velocity = zero;
+	};
+
+	clamp(s.local_y, s.local_velocity);
+	clamp(s.remote_y, s.remote_velocity);
+	s.ball_x += s.ball_velocity_x;
+	s.ball_y += s.ball_velocity_y;
+	s.local_y += s.local_velocity;
+	s.remote_y += s.remote_velocity;
+}
+
+// a base tick, as far as Discrete moves
+void Benchmark::Swept(State* const state)
+{
+	Physics::Step(Number::FromFloat(1.f), state);
+}
+
+Benchmark::State Benchmark::Start(const float speed)
+{
+	const auto velocity = kBallVelocity * speed;
+	return State {
+		Number::FromFloat(kWinWidth / 2.f), Number::FromFloat(kWinHeight / 2.f),
+		Number::FromFloat(velocity), Number::FromFloat(velocity / 4.f),
+		Number::FromFloat(kPaddleWidth / 2.f), Number::FromFloat(kWinHeight / 2.f), Number::FromFloat(0.f),
+		Number::FromFloat(kWinWidth - kPaddleWidth / 2.f), Number::FromFloat(kWinHeight / 2.f), Number::FromFloat(0.f)
+	};
+}
+
+// the paddle heads for the ball, or stays when close enough
+Benchmark::T Benchmark::Follow(const State& state, const T y, const T speed)
+{
+	constexpr const T slack {Number::FromFloat(kPaddleHeight / 4.f)};
+	if (state.ball_y < y - slack)
+		return -speed;
+	else if (state.ball_y > y + slack)
+		return speed;
+	return Number::FromFloat(0.f);
+}
+
+bool Benchmark::Inside(const State& state, const T x, const T y)
+{
+	using std::abs;
+	constexpr const T zero {Number::FromFloat(0.f)};
+	constexpr const T radius {Number::FromFloat(kBallRadius / 2.f)};
+	const auto outside_x = std::max(zero, abs(state.ball_x - x) - Number::FromFloat(kPaddleWidth / 2.f));
+	const auto outside_y = std::max(zero, abs(state.ball_y - y) - Number::FromFloat(kPaddleHeight / 2.f));
+	return outside_x * outside_x + outside_y * outside_y < radius * radius;
+}
+
+// the ball's center crossed the paddle's middle, level with it before and
+// after, from outside. a paddle moving onto the ball isn't the check's
+// doing
+bool Benchmark::Through(const State& before, const State& after, const T x, const T y)
+{
+	using std::abs;
+	constexpr const T reach {Number::FromFloat(kPaddleHeight / 2.f + kBallRadius / 2.f)};
+	const bool crossed = (before.ball_x < x) != (after.ball_x < x);
+	return crossed && !Inside(before, x, y) && abs(before.ball_y - y) <= reach && abs(after.ball_y - y) <= reach;
+}
+
+// timed on random inputs first, then counted with the paddles following
+// the ball, which is when it meets them. both counts are against where
+// the paddles were when the ball moved, before they moved themselves
+Benchmark::Result Benchmark::Measure(const Step step, const float speed, const std::vector<sf::Uint8>& inputs)
+{
+	constexpr const T paddle_speed {Number::FromFloat(kPaddleVelocity)};
+	const T velocities[3] {-paddle_speed, Number::FromFloat(0.f), paddle_speed};
+	Result result {};
+
+	auto state = Start(speed);
+	const auto start = std::chrono::steady_clock::now();
+	for (const auto input : inputs) {
+		state.local_velocity = velocities[input % 3];
+		state.remote_velocity = velocities[input / 3];
+		step(&state);
+	}
+	const std::chrono::duration<double, std::nano> elapsed {std::chrono::steady_clock::now() - start};
+	result.nanoseconds = elapsed.count() / static_cast<double>(inputs.size());
+	// the state depends on every frame, so none of them is optimized out
+	if (state.ball_x == Number::FromFloat(-1.f))
+		std::cout << '\n';
+
+	state = Start(speed);
+	for (std::size_t frame = 0; frame < inputs.size(); ++frame) {
+		const auto before = state;
+		state.local_velocity = Follow(state, state.local_y, paddle_speed);
+		state.remote_velocity = Follow(state, state.remote_y, paddle_speed);
+		step(&state);
+		result.through += Through(before, state, state.local_x, before.local_y);
+		result.through += Through(before, state, state.remote_x, before.remote_y);
+		result.inside += Inside(state, state.local_x, before.local_y);
+		result.inside += Inside(state, state.remote_x, before.remote_y);
+	}
+	return result;
+}
@@ -0,0 +1,15 @@
+#ifndef PONGON_BENCHMARK_HPP_
+#define PONGON_BENCHMARK_HPP_
+
+// runs the ball against the paddles, both following it, for frames
+// frames at a few speeds, once with the discrete overlap check the game
+// used to flip the ball on and once with Physics::Step's sweep. prints
+// how long a frame took with each, how often the ball went through a
+// paddle and how many frames it ended inside one
+namespace Benchmark {
+	constexpr const float kSpeeds[] {1.f, 4.f, 8.f, 16.f, 32.f};
+
+	bool Run(int frames);
+}
+
+#endif
@@ -0,0 +1,1040 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <cmath>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <atomic>
+
+#include "connection.hpp"
+#include "lobby.hpp"
+#include "protocol.hpp"
+#include "spsc_queue.hpp"
+#include "wire.hpp"
+
+namespace Connection {
+	sf::TcpSocket socket;
+	sf::Socket::Status status;
+	Transport transport;
+	bool is_server;
+	static std::string local_nick;
+	static std::string remote_nick;
+	static sf::Uint8 pending_id;
+	static sf::Uint8 received_id;
+	static std::thread stdin_updater;
+	static bool is_running;
+
+	// the line being sent, none when its size is 0, and the last kChatLines
+	// shown, chat_count being how many there were so far
+	constexpr const std::size_t kChatLines {20};
+	constexpr const std::size_t kMaxLineSize {50};
+	static ChatLine pending;
+	static ChatLine chat_lines[kChatLines];
+	static std::size_t chat_count;
+	// a line typed on the stdin thread, which reads the next one once the
+	// game thread took it
+	static SpscQueue<ChatLine, 1> typed_lines;
+
+	// outgoing messages are queued with the tcp size prefix, which udp
+	// leaves out, and incoming ones without it. either side drops the
+	// messages of another session than its own
+	struct Message {
+		sf::Uint32 session;
+		std::size_t size;
+		char data[kFrameHeaderSize + kMaxMessageSize];
+	};
+
+	static SpscQueue<Message, kQueueSize> outgoing;
+	static SpscQueue<Message, kQueueSize> incoming;
+	static std::thread network_thread;
+	static std::atomic<bool> network_running;
+	// set by the network thread when it stops on a socket error
+	static std::atomic<sf::Socket::Status> network_status;
+	static sf::Uint64 dropped;
+
+	// ping samples kept to pick the clock offset from
+	constexpr const int kFilterSize {8};
+	struct Sample {
+		sf::Int64 delay;
+		sf::Int64 offset;
+	};
+
+	static const sf::Clock clock;
+	// kept by the network thread
+	static Sample filter[kFilterSize];
+	static sf::Int64 srtt;
+	static sf::Int64 rttvar;
+	// published to the game, in microseconds
+	static std::atomic<sf::Int64> rtt_us;
+	static std::atomic<sf::Int64> min_rtt_us;
+	static std::atomic<sf::Int64> jitter_us;
+	static std::atomic<sf::Int64> offset_us;
+	static std::atomic<sf::Uint32> samples;
+
+	// kept by the network thread, the game thread pops the newest copy
+	static Metrics metrics;
+	static SpscQueue<Metrics, 4> published_metrics;
+	static Metrics latest_metrics;
+
+	// the port the client connects to, kPort unless given with the address
+	static unsigned short server_port;
+	static sf::IpAddress server_ip;
+	// where to get the server from instead, when not null
+	static const char* lobby;
+	static sf::Time timeout;
+	static int retries;
+	// set by the network thread once connected, and when
+	static std::atomic<bool> established;
+	static std::atomic<sf::Int64> established_at;
+	// bumped by the network thread on every connection, the game thread
+	// moves to it with BeginSession
+	static std::atomic<sf::Uint32> session;
+	static std::atomic<bool> reconnecting;
+	static sf::Uint32 game_session;
+	static sf::Uint32 session_token;
+	// the server keeps listening for its client to come back
+	static sf::TcpListener listener;
+	// when the network thread last got a pong
+	static sf::Int64 last_pong;
+
+	static bool TcpConnect(sf::Time limit, int max_retries);
+	static bool Greet(sf::Time limit);
+	static void NetworkLoop();
+	static sf::Socket::Status Serve();
+	static sf::Socket::Status Flush();
+	static void SendControl(const char* data, std::size_t size);
+	static void HandleControl(const char* data, std::size_t size);
+	static void AddSample(sf::Int64 delay, sf::Int64 offset);
+	static void Count(bool sending, sf::Socket::Status ret, sf::Int64 start, std::size_t bytes);
+	static sf::Socket::Status ReceiveFrame(char* message, std::size_t* size);
+	static void ProcessChat(const char* message, std::size_t size);
+	static void AddChat(const ChatLine& line);
+
+	static char tx_buffer[4 * (kFrameHeaderSize + kMaxMessageSize)];
+	static std::size_t tx_size;
+	static char rx_buffer[4 * (kFrameHeaderSize + kMaxMessageSize)];
+	static std::size_t rx_size;
+
+	namespace Udp {
+		enum Channel : sf::Uint8 {Hello, State, Control, ChannelCount};
+		constexpr const std::size_t kHeaderSize {5};
+		constexpr const std::size_t kMaxDatagramSize {512};
+		constexpr const float kResendInterval {0.25f};
+		constexpr const float kTimeout {5.f};
+		static sf::UdpSocket socket;
+		static sf::IpAddress remote_ip;
+		static unsigned short remote_port;
+		static sf::Uint32 send_seq[ChannelCount];
+		static sf::Uint32 receive_seq[ChannelCount];
+		static char state[kMaxDatagramSize];
+		static std::size_t state_size;
+		static bool has_state;
+		static sf::Clock last_heard;
+		static_assert(kMaxDatagramSize - kHeaderSize >= kMaxMessageSize,
+		              "a message must fit in a datagram");
+
+		static sf::Socket::Status SendDatagram(Channel channel, const void* data, std::size_t size);
+		static void SendHello();
+		// false when the payload is too short to hold the tag
+		static bool ReadHello(const char* data, std::size_t size, std::string* nick, sf::Uint32* tag);
+		static void Poll();
+	}
+}
+
+
+bool Connection::Init(const Mode mode, const Transport transport_mode,
+                      const sf::Time connect_timeout, const int connect_retries,
+                      const char* const lobby_address)
+{
+	is_running = false;
+	is_server = mode == Mode::Server;
+	transport = transport_mode;
+	timeout = connect_timeout;
+	retries = connect_retries;
+	lobby = lobby_address;
+	do {
+		std::cout << "enter your nickname: ";
+		std::getline(std::cin, local_nick);
+	} while (local_nick.size() == 0);
+
+	if (local_nick.size() > 10)
+		local_nick.resize(10);
+
+	if (is_server) {
+		std::cout << "booting as server...\n";
+	} else if (lobby != nullptr) {
+		std::cout << "booting as client of the lobby at " << lobby << "...\n";
+	} else {
+		std::cout << "booting as client...\n";
+		std::cout << "enter the server\'s ip address: ";
+		std::string address;
+		std::cin >> address;
+		const auto colon = address.find(':');
+		server_port = kPort;
+		if (colon != std::string::npos) {
+			server_port = static_cast<unsigned short>(std::atoi(address.c_str() + colon + 1));
+			address.resize(colon);
+		}
+		server_ip = address;
+	}
+
+	samples = 0;
+	established = false;
+	session = 0;
+	reconnecting = false;
+	session_token = 0;
+	network_status = sf::Socket::Done;
+	network_running = true;
+	network_thread = std::thread(NetworkLoop);
+	return true;
+}
+
+bool Connection::Handshake(bool* const done)
+{
+	*done = false;
+	if (network_status != sf::Socket::Done) {
+		status = network_status;
+		return false;
+	}
+
+	// the first pings go right away on both sides, wait for them to
+	// have an estimate before the game starts
+	const auto sync_time = sf::seconds(2 * kSyncPings * kSyncInterval).asMicroseconds();
+	if (!established || (samples < kSyncPings && Now() - established_at < sync_time))
+		return true;
+
+	*done = true;
+	BeginSession();
+	std::cout << "connected to: " << remote_nick << '\n';
+	if (samples > 0) {
+		const auto timing = GetTiming();
+		ChatLine line;
+		const auto size = std::snprintf(line.text, sizeof(line.text), "PongOn:> round trip %d ms, jitter %d ms",
+		                                static_cast<int>(timing.rtt.asMilliseconds()),
+		                                static_cast<int>(timing.jitter.asMilliseconds()));
+		line.size = std::min<std::size_t>(std::max(size, 0), sizeof(line.text) - 1);
+		AddChat(line);
+	}
+	PrintChat();
+
+	is_running = true;
+	stdin_updater = std::thread([] {
+		std::string aux_str;
+		while (is_running) {
+			if (typed_lines.Full()) {
+				sf::sleep(sf::milliseconds(10));
+				continue;
+			}
+			std::getline(std::cin, aux_str);
+			if (aux_str != "" && aux_str != " " &&
+			  aux_str != "\n" && aux_str != "\t" &&
+			  aux_str != "\0") {
+				ChatLine typed {0, {}};
+				AppendChat(aux_str.data(), std::min(aux_str.size(), kMaxLineSize), &typed);
+				typed_lines.Push(typed);
+			}
+		}
+	});
+
+	stdin_updater.detach();
+	return true;
+}
+
+void Connection::Close()
+{
+	// wait for threads to finish
+	network_running = false;
+	if (network_thread.joinable())
+		network_thread.join();
+	socket.disconnect();
+	listener.close();
+	Udp::Close();
+	is_running = false;
+	if (stdin_updater.joinable())
+		stdin_updater.join();
+}
+
+// runs on the network thread. every wait is bounded by limit and ends
+// early when Close stops the thread
+bool Connection::TcpConnect(const sf::Time limit, const int max_retries)
+{
+	const sf::Clock connect_clock;
+	const auto time_left = [&connect_clock, limit] {
+		return std::max(limit - connect_clock.getElapsedTime(), sf::milliseconds(1));
+	};
+	const auto expired = [&connect_clock, limit] {
+		return !network_running || connect_clock.getElapsedTime() >= limit;
+	};
+
+	socket.setBlocking(true);
+	if (is_server) {
+		if (session == 0) {
+			if (listener.listen(kPort) != sf::Socket::Done) {
+				std::cerr << "failed to listen port " << kPort << '\n';
+				return false;
+			}
+			listener.setBlocking(false);
+			std::cout << "waiting for client...\n";
+		}
+
+		// a client failing the greeting, or with the wrong token, is let go
+		for (;;) {
+			while (listener.accept(socket) != sf::Socket::Done) {
+				if (expired()) {
+					std::cerr << "no client connected\n";
+					return false;
+				}
+				sf::sleep(sf::milliseconds(10));
+			}
+			if (Greet(time_left()))
+				return true;
+			socket.disconnect();
+		}
+	}
+
+	// the server may not be up yet, a refused connection is retried
+	for (int attempt = 0; ; ++attempt) {
+		if (socket.connect(server_ip, server_port, time_left()) == sf::Socket::Done && Greet(time_left()))
+			return true;
+		socket.disconnect();
+		if (attempt >= max_retries || expired()) {
+			std::cerr << "connection failed!\n";
+			return false;
+		}
+		sf::sleep(std::min(sf::seconds(kRetryInterval), time_left()));
+	}
+}
+
+// the client goes first with its nick, the session token, 0 when it has
+// none, and the protocol tag, and the server answers with its own. a
+// server hands out a token on the first connection and only takes that
+// one back afterwards. a dedicated server sends only its nick, it checks
+// the tag on its side and its clients can't reconnect
+bool Connection::Greet(const sf::Time limit)
+{
+	sf::Packet send_pack, receive_pack;
+	sf::SocketSelector selector;
+	selector.add(socket);
+	std::string nick;
+	sf::Uint32 token = 0;
+	sf::Uint32 tag = 0;
+
+	if (is_server) {
+		if (!selector.wait(limit) || socket.receive(receive_pack) != sf::Socket::Done ||
+		    !(receive_pack >> nick >> token >> tag)) {
+			return false;
+		} else if (tag != Protocol::Tag(tick_rate())) {
+			std::cerr << "rejected a client with another protocol\n";
+			return false;
+		} else if (session == 0) {
+			std::random_device random;
+			session_token = std::max<sf::Uint32>(random(), 1);
+		} else if (token != session_token) {
+			std::cerr << "rejected a client with the wrong session token\n";
+			return false;
+		}
+
+		send_pack << local_nick << session_token << Protocol::Tag(tick_rate());
+		if (socket.send(send_pack) != sf::Socket::Done)
+			return false;
+	} else {
+		send_pack << local_nick << session_token << Protocol::Tag(tick_rate());
+		if (socket.send(send_pack) != sf::Socket::Done || !selector.wait(limit) ||
+		    socket.receive(receive_pack) != sf::Socket::Done || !(receive_pack >> nick)) {
+			return false;
+		} else if (!(receive_pack >> token)) {
+			token = 0;
+		} else if (!(receive_pack >> tag) || tag != Protocol::Tag(tick_rate())) {
+			std::cerr << "the server runs another protocol\n";
+			return false;
+		} else if (session > 0 && token != session_token) {
+			return false;
+		}
+		session_token = token;
+	}
+
+	if (session == 0)
+		remote_nick = nick;
+	return true;
+}
+
+bool Connection::SendMessage(const void* const payload, const std::size_t size)
+{
+	assert(size <= kMaxPayloadSize);
+
+	// a new line is only taken once the previous one was delivered
+	ChatLine typed;
+	if (pending.size == 0 && typed_lines.Pop(&typed)) {
+		AppendChat(local_nick.data(), local_nick.size(), &pending);
+		AppendChat(":> ", 3, &pending);
+		AppendChat(typed.text, typed.size, &pending);
+		AddChat(pending);
+		++pending_id;
+		PrintChat();
+	}
+
+	if (network_status != sf::Socket::Done) {
+		status = network_status;
+		return false;
+	}
+
+	Message message;
+	message.session = game_session;
+	message.size = WriteMessage(pending_id, received_id, pending.text,
+	                            pending.size, payload, size, message.data);
+
+	// the network thread is stuck behind the peer. only the netcodes that
+	// resend unacknowledged inputs can get this far ahead, so it is safe
+	// to drop, the chat line stays pending
+	if (!outgoing.Push(message)) {
+		++dropped;
+		return true;
+	}
+
+	// udp keeps resending the line until it is acknowledged
+	if (transport == Transport::Tcp)
+		pending.size = 0;
+	return true;
+}
+
+std::size_t Connection::WriteMessage(const sf::Uint8 chat_id, const sf::Uint8 chat_ack,
+                                     const char* const chat, const std::size_t chat_size,
+                                     const void* const payload, const std::size_t size,
+                                     char* const dest)
+{
+	assert(chat_size <= kMaxChatSize && size <= kMaxPayloadSize);
+	const auto message_size = kChatHeaderSize + chat_size + size;
+	char* const message = dest + kFrameHeaderSize;
+	dest[0] = static_cast<char>(message_size >> 8);
+	dest[1] = static_cast<char>(message_size);
+	message[0] = static_cast<char>(chat_id);
+	message[1] = static_cast<char>(chat_ack);
+	message[2] = static_cast<char>(chat_size);
+	std::memcpy(message + kChatHeaderSize, chat, chat_size);
+	std::memcpy(message + kChatHeaderSize + chat_size, payload, size);
+	return kFrameHeaderSize + message_size;
+}
+
+bool Connection::ReceiveMessage(void* const payload, const std::size_t capacity, std::size_t* const size)
+{
+	Message received;
+	*size = 0;
+
+	// what is left from a previous session is skipped
+	bool popped;
+	while ((popped = incoming.Pop(&received)) && received.session != game_session)
+		continue;
+	if (!popped) {
+		if (network_status != sf::Socket::Done) {
+			status = network_status;
+			return false;
+		}
+		return true;
+	}
+
+	// udp only ever cares about the newest state
+	if (transport == Transport::Udp) {
+		while (incoming.Pop(&received))
+			continue;
+	}
+
+	const char* const message = received.data;
+	const auto message_size = received.size;
+	const std::size_t chat_size = static_cast<unsigned char>(message[2]);
+	if (message_size < kChatHeaderSize + chat_size ||
+	    message_size - kChatHeaderSize - chat_size > capacity) {
+		status = sf::Socket::Error;
+		return false;
+	}
+
+	ProcessChat(message, chat_size);
+	*size = message_size - kChatHeaderSize - chat_size;
+	std::memcpy(payload, message + kChatHeaderSize + chat_size, *size);
+	return true;
+}
+
+void Connection::ProcessChat(const char* const message, const std::size_t chat_size)
+{
+	const auto remote_chat_id = static_cast<sf::Uint8>(message[0]);
+	const auto remote_chat_ack = static_cast<sf::Uint8>(message[1]);
+
+	if (pending.size > 0 && remote_chat_ack == pending_id)
+		pending.size = 0;
+
+	if (chat_size > 0 && remote_chat_id != received_id) {
+		received_id = remote_chat_id;
+		ChatLine line {0, {}};
+		AppendChat(message + kChatHeaderSize, chat_size, &line);
+		AddChat(line);
+		PrintChat();
+	}
+}
+
+void Connection::AddChat(const ChatLine& line)
+{
+	chat_lines[chat_count % kChatLines] = line;
+	++chat_count;
+}
+
+void Connection::AppendChat(const char* const text, const std::size_t size, ChatLine* const line)
+{
+	const auto count = std::min(size, kMaxChatSize - line->size);
+	std::memcpy(line->text + line->size, text, count);
+	line->size += count;
+}
+
+sf::Uint32 Connection::Session()
+{
+	return session;
+}
+
+void Connection::BeginSession()
+{
+	game_session = session;
+}
+
+bool Connection::Reconnecting()
+{
+	return reconnecting;
+}
+
+void Connection::PrintStats()
+{
+	std::cout << "network thread: incoming queue peak " << incoming.HighWater() << '/' << kQueueSize
+	          << ", outgoing queue peak " << outgoing.HighWater() << '/' << kQueueSize
+	          << ", " << dropped << " messages dropped\n";
+
+	const auto totals = GetMetrics();
+	const auto failed = totals.statuses[sf::Socket::Partial] + totals.statuses[sf::Socket::Disconnected] +
+	                    totals.statuses[sf::Socket::Error];
+	std::cout << "socket: " << totals.bytes_sent << " bytes sent in " << totals.packets_sent << " packets, "
+	          << totals.bytes_received << " received in " << totals.packets_received << ", "
+	          << totals.send_time / std::max<sf::Int64>(totals.sends, 1) << " us a send, "
+	          << totals.receive_time / std::max<sf::Int64>(totals.receives, 1) << " us a receive, "
+	          << failed << " calls failed\n";
+
+	// half the round trip plus the jitter, in frames
+	const auto timing = GetTiming();
+	const auto one_way = timing.rtt.asSeconds() / 2.f + timing.jitter.asSeconds();
+	std::cout << "timing: round trip " << timing.rtt.asMicroseconds() / 1000.f << " ms"
+	          << " (min " << timing.min_rtt.asMicroseconds() / 1000.f << " ms)"
+	          << ", jitter " << timing.jitter.asMicroseconds() / 1000.f << " ms"
+	          << ", clock offset " << timing.offset.asMicroseconds() / 1000.f << " ms"
+	          << ", " << timing.samples << " samples"
+	          << ", suggested -delay " << static_cast<int>(std::ceil(one_way * 60.f)) << '\n';
+}
+
+Connection::Metrics Connection::GetMetrics()
+{
+	while (published_metrics.Pop(&latest_metrics))
+		continue;
+	return latest_metrics;
+}
+
+Connection::Timing Connection::GetTiming()
+{
+	return {sf::microseconds(rtt_us), sf::microseconds(min_rtt_us),
+	        sf::microseconds(jitter_us), sf::microseconds(offset_us), samples};
+}
+
+sf::Int64 Connection::Now()
+{
+	return clock.getElapsedTime().asMicroseconds();
+}
+
+std::size_t Connection::WritePong(const char* const ping, char* const dest)
+{
+	const auto now = static_cast<sf::Uint32>(Now());
+	dest[0] = static_cast<char>(kPong);
+	std::memcpy(dest + 1, ping + 1, 4);
+	Wire::WriteU32(now, dest + 5);
+	Wire::WriteU32(now, dest + 9);
+	return kPongSize;
+}
+
+// owns the socket once connected: sends what the game queued, queues
+// what arrives and sleeps on the socket for at most a millisecond, which
+// is as long as an outgoing message can wait to be picked up
+void Connection::NetworkLoop()
+{
+	// the ticket goes as the session token, the match server doesn't hand
+	// out one back
+	if (lobby != nullptr) {
+		Lobby::Ticket ticket;
+		if (!Lobby::Join(lobby, timeout, network_running, &ticket)) {
+			network_status = sf::Socket::Error;
+			return;
+		}
+		server_ip = sf::IpAddress(ticket.address);
+		server_port = ticket.port;
+		session_token = ticket.id;
+		std::cout << "the lobby sent us to " << server_ip << ':' << server_port << '\n';
+	}
+
+	const bool connected = transport == Transport::Udp ? Udp::Connect(server_ip) : TcpConnect(timeout, retries);
+	if (!connected) {
+		network_status = sf::Socket::Error;
+		return;
+	}
+
+	established_at = Now();
+	established = true;
+	++session;
+
+	// a dropped tcp connection is given kReconnectGrace seconds to come
+	// back, the game keeps running meanwhile
+	for (;;) {
+		const auto ret = Serve();
+		if (!network_running)
+			return;
+		if (transport == Transport::Udp || session_token == 0) {
+			network_status = ret;
+			return;
+		}
+
+		std::cerr << "connection lost, reconnecting...\n";
+		reconnecting = true;
+		socket.disconnect();
+		tx_size = 0;
+		rx_size = 0;
+		if (!TcpConnect(sf::seconds(kReconnectGrace), std::numeric_limits<int>::max())) {
+			network_status = ret;
+			return;
+		}
+
+		std::cout << "reconnected to: " << remote_nick << '\n';
+		++session;
+		reconnecting = false;
+	}
+}
+
+// until the socket fails or the thread is stopped. a connection that can
+// be reestablished is also taken as lost when the pings go unanswered for
+// kLinkTimeout seconds, and on the server when the client connects again,
+// as either side may not see the other one go
+sf::Socket::Status Connection::Serve()
+{
+	sf::SocketSelector selector;
+	const bool resumable = transport == Transport::Tcp && session_token != 0;
+	if (transport == Transport::Udp) {
+		selector.add(Udp::socket);
+	} else {
+		socket.setBlocking(false);
+		selector.add(socket);
+	}
+	if (resumable && is_server)
+		selector.add(listener);
+	last_pong = Now();
+
+	Message message;
+	sf::Int64 next_ping = 0;
+	sf::Int64 next_metrics = 0;
+	int pings = 0;
+	while (network_running) {
+		// a full queue means the game isn't reading them, this one can go
+		if (Now() >= next_metrics) {
+			published_metrics.Push(metrics);
+			next_metrics = Now() + sf::seconds(kMetricsInterval).asMicroseconds();
+		}
+
+		if (Now() >= next_ping) {
+			char ping[kPingSize];
+			ping[0] = static_cast<char>(kPing);
+			Wire::WriteU32(static_cast<sf::Uint32>(Now()), ping + 1);
+			SendControl(ping, sizeof(ping));
+			const auto interval = ++pings < kSyncPings ? kSyncInterval : kPingInterval;
+			next_ping = Now() + sf::seconds(interval).asMicroseconds();
+		}
+
+		auto ret = Flush();
+		while (ret == sf::Socket::Done && !incoming.Full()) {
+			if (transport == Transport::Udp)
+				ret = Udp::Receive(message.data, kMaxMessageSize, message.size);
+			else
+				ret = ReceiveFrame(message.data, &message.size);
+			if (ret != sf::Socket::Done || message.size == 0)
+				break;
+			message.session = session;
+			incoming.Push(message);
+		}
+
+		if (ret != sf::Socket::Done)
+			return ret;
+		else if (resumable && Now() - last_pong > sf::seconds(kLinkTimeout).asMicroseconds())
+			return sf::Socket::Disconnected;
+		else if (selector.wait(sf::milliseconds(1)) && resumable && is_server && selector.isReady(listener))
+			return sf::Socket::Disconnected;
+	}
+	return sf::Socket::Done;
+}
+
+// moves the queued messages to the socket. tcp keeps what the socket
+// can't take yet in tx_buffer, while a udp datagram is sent or lost
+sf::Socket::Status Connection::Flush()
+{
+	Message message;
+	while (tx_size + sizeof(message.data) <= sizeof(tx_buffer) && outgoing.Pop(&message)) {
+		if (message.session != session) {
+			continue;
+		} else if (transport == Transport::Udp) {
+			const auto ret = Udp::Send(message.data + kFrameHeaderSize, message.size - kFrameHeaderSize);
+			if (ret != sf::Socket::Done)
+				return ret;
+		} else {
+			std::memcpy(tx_buffer + tx_size, message.data, message.size);
+			tx_size += message.size;
+			++metrics.packets_sent;
+		}
+	}
+
+	if (tx_size == 0)
+		return sf::Socket::Done;
+
+	std::size_t sent = 0;
+	const auto start = Now();
+	const auto ret = socket.send(tx_buffer, tx_size, sent);
+	Count(true, ret, start, sent);
+	if (ret == sf::Socket::Disconnected || ret == sf::Socket::Error)
+		return ret;
+
+	tx_size -= sent;
+	std::memmove(tx_buffer, tx_buffer + sent, tx_size);
+	return sf::Socket::Done;
+}
+
+// control frames jump ahead of the queued messages, and are dropped when
+// tcp has no room for them
+void Connection::SendControl(const char* const data, const std::size_t size)
+{
+	if (transport == Transport::Udp) {
+		Udp::SendDatagram(Udp::Control, data, size);
+	} else if (tx_size + kFrameHeaderSize + size <= sizeof(tx_buffer)) {
+		tx_buffer[tx_size] = static_cast<char>((kControlFrame | size) >> 8);
+		tx_buffer[tx_size + 1] = static_cast<char>(size);
+		std::memcpy(tx_buffer + tx_size + kFrameHeaderSize, data, size);
+		tx_size += kFrameHeaderSize + size;
+		++metrics.packets_sent;
+	}
+}
+
+void Connection::HandleControl(const char* const data, const std::size_t size)
+{
+	if (size == kPingSize && data[0] == kPing) {
+		char pong[kPongSize];
+		SendControl(pong, WritePong(data, pong));
+	} else if (size == kPongSize && data[0] == kPong) {
+		const auto received = static_cast<sf::Uint32>(Now());
+		const auto sent = Wire::ReadU32(data + 1);
+		const auto peer_received = Wire::ReadU32(data + 5);
+		const auto peer_sent = Wire::ReadU32(data + 9);
+		// wrap safe differences, the clocks only have to be within half
+		// an hour of each other
+		const auto diff = [](const sf::Uint32 a, const sf::Uint32 b) {
+			return static_cast<sf::Int64>(static_cast<sf::Int32>(a - b));
+		};
+		const auto delay = diff(received, sent) - diff(peer_sent, peer_received);
+		const auto offset = (diff(peer_received, sent) + diff(peer_sent, received)) / 2;
+		AddSample(std::max<sf::Int64>(delay, 0), offset);
+		last_pong = Now();
+	}
+}
+
+void Connection::AddSample(const sf::Int64 delay, const sf::Int64 offset)
+{
+	const auto count = samples + 1;
+	filter[(count - 1) % kFilterSize] = {delay, offset};
+	auto best = filter[0];
+	for (sf::Uint32 i = 1; i < std::min<sf::Uint32>(count, kFilterSize); ++i) {
+		if (filter[i].delay < best.delay)
+			best = filter[i];
+	}
+
+	if (count == 1) {
+		srtt = delay;
+		rttvar = delay / 2;
+	} else {
+		rttvar = (3 * rttvar + std::abs(srtt - delay)) / 4;
+		srtt = (7 * srtt + delay) / 8;
+	}
+
+	rtt_us = srtt;
+	min_rtt_us = best.delay;
+	jitter_us = rttvar;
+	offset_us = best.offset;
+	samples = count;
+}
+
+// udp datagrams are counted here, tcp frames where they are cut out of
+// the stream
+void Connection::Count(const bool sending, const sf::Socket::Status ret, const sf::Int64 start,
+                       const std::size_t bytes)
+{
+	const auto elapsed = Now() - start;
+	const bool datagram = transport == Transport::Udp && ret == sf::Socket::Done;
+	if (sending) {
+		metrics.bytes_sent += bytes;
+		metrics.packets_sent += datagram;
+		++metrics.sends;
+		metrics.send_time += elapsed;
+	} else {
+		metrics.bytes_received += bytes;
+		metrics.packets_received += datagram;
+		++metrics.receives;
+		metrics.receive_time += elapsed;
+	}
+	++metrics.statuses[ret];
+}
+
+// pops the next message out of the receive buffer, reading the socket
+// when it doesn't hold a whole one. size is 0 when nothing complete
+// arrived yet
+sf::Socket::Status Connection::ReceiveFrame(char* const message, std::size_t* const size)
+{
+	*size = 0;
+	for (;;) {
+		if (rx_size >= kFrameHeaderSize) {
+			const auto* const bytes = reinterpret_cast<const unsigned char*>(rx_buffer);
+			const std::size_t header = (std::size_t(bytes[0]) << 8) | bytes[1];
+			const auto message_size = header & ~std::size_t(kControlFrame);
+			if (message_size > kMaxMessageSize)
+				return sf::Socket::Error;
+
+			const auto frame_size = kFrameHeaderSize + message_size;
+			if (rx_size >= frame_size)
+				++metrics.packets_received;
+			if (rx_size >= frame_size && (header & kControlFrame)) {
+				HandleControl(rx_buffer + kFrameHeaderSize, message_size);
+				rx_size -= frame_size;
+				std::memmove(rx_buffer, rx_buffer + frame_size, rx_size);
+				continue;
+			} else if (rx_size >= frame_size) {
+				std::memcpy(message, rx_buffer + kFrameHeaderSize, message_size);
+				rx_size -= frame_size;
+				std::memmove(rx_buffer, rx_buffer + frame_size, rx_size);
+				*size = message_size;
+				return sf::Socket::Done;
+			}
+		}
+
+		std::size_t received = 0;
+		const auto start = Now();
+		const auto ret = socket.receive(rx_buffer + rx_size, sizeof(rx_buffer) - rx_size, received);
+		Count(false, ret, start, received);
+		if (ret == sf::Socket::NotReady)
+			return sf::Socket::Done;
+		else if (ret != sf::Socket::Done)
+			return ret;
+		rx_size += received;
+	}
+}
+
+
+void Connection::PrintChat()
+{
+#ifdef __linux__
+	std::system("clear");
+#elif defined(_WIN32)
+	std::system("cls");
+#endif
+
+	std::cout << "======================== CHAT ========================\n";
+	const auto first = chat_count < kChatLines ? 0 : chat_count - kChatLines;
+	for (auto line = first; line < chat_count; ++line) {
+		const auto& chat = chat_lines[line % kChatLines];
+		std::cout.write(chat.text, static_cast<std::streamsize>(chat.size)) << '\n';
+	}
+	for (auto line = chat_count - first; line < kChatLines; ++line)
+		std::cout << '\n';
+	std::cout << "======================== CHAT ========================\n";
+}
+
+
+// the hello datagram carries the nickname followed by the protocol tag,
+// a peer with another one is turned away as Greet does. the client keeps
+// resending it until the server answers, and the server answers every
+// hello it gets, so a lost hello on either direction is recovered
+bool Connection::Udp::Connect(const sf::IpAddress& serverIp)
+{
+	char buffer[kMaxDatagramSize];
+	std::size_t received;
+	sf::IpAddress ip;
+	unsigned short port;
+	std::string nick;
+	sf::Uint32 tag;
+
+	if (is_server) {
+		if (socket.bind(kPort) != sf::Socket::Done) {
+			std::cerr << "failed to bind port " << kPort << '\n';
+			return false;
+		}
+
+		std::cout << "waiting for client...\n";
+		socket.setBlocking(false);
+		const sf::Clock timeout_clock;
+		while (socket.receive(buffer, sizeof(buffer), received, ip, port) != sf::Socket::Done ||
+		       received < kHeaderSize || buffer[4] != Hello ||
+		       !ReadHello(buffer + kHeaderSize, received - kHeaderSize, &nick, &tag)) {
+			if (!network_running || timeout_clock.getElapsedTime() >= timeout) {
+				std::cerr << "no client connected\n";
+				return false;
+			}
+			sf::sleep(sf::milliseconds(10));
+		}
+
+		if (tag != Protocol::Tag(tick_rate())) {
+			std::cerr << "rejected a client with another protocol\n";
+			return false;
+		}
+		remote_ip = ip;
+		remote_port = port;
+		SendHello();
+	} else {
+		if (socket.bind(sf::Socket::AnyPort) != sf::Socket::Done) {
+			std::cerr << "failed to bind udp socket\n";
+			return false;
+		}
+
+		remote_ip = serverIp;
+		remote_port = server_port;
+		socket.setBlocking(false);
+		sf::Clock resend_clock;
+		const sf::Clock timeout_clock;
+		SendHello();
+		for (;;) {
+			const auto ret = socket.receive(buffer, sizeof(buffer), received, ip, port);
+			if (ret == sf::Socket::Done && ip == remote_ip && port == remote_port &&
+			    received >= kHeaderSize && buffer[4] == Hello &&
+			    ReadHello(buffer + kHeaderSize, received - kHeaderSize, &nick, &tag)) {
+				break;
+			} else if (!network_running || timeout_clock.getElapsedTime() >= timeout) {
+				std::cerr << "connection failed!\n";
+				return false;
+			} else if (resend_clock.getElapsedTime().asSeconds() > kResendInterval) {
+				SendHello();
+				resend_clock.restart();
+			}
+			sf::sleep(sf::milliseconds(10));
+		}
+
+		if (tag != Protocol::Tag(tick_rate())) {
+			std::cerr << "the server runs another protocol\n";
+			return false;
+		}
+	}
+
+	remote_nick = nick;
+	if (remote_nick.size() > 10)
+		remote_nick.resize(10);
+
+	socket.setBlocking(false);
+	last_heard.restart();
+	return true;
+}
+
+void Connection::Udp::Close()
+{
+	socket.unbind();
+	has_state = false;
+}
+
+sf::Socket::Status Connection::Udp::Send(const void* const data, const std::size_t size)
+{
+	return SendDatagram(State, data, size);
+}
+
+sf::Socket::Status Connection::Udp::Receive(void* const data, const std::size_t size, std::size_t& received)
+{
+	Poll();
+	received = 0;
+	if (has_state && state_size <= size) {
+		std::memcpy(data, state, state_size);
+		received = state_size;
+		has_state = false;
+	}
+
+	if (last_heard.getElapsedTime().asSeconds() > kTimeout)
+		return sf::Socket::Disconnected;
+	return sf::Socket::Done;
+}
+
+sf::Socket::Status Connection::Udp::SendDatagram(const Channel channel, const void* const data, const std::size_t size)
+{
+	assert(size <= kMaxDatagramSize - kHeaderSize);
+	char buffer[kMaxDatagramSize];
+	Wire::WriteU32(++send_seq[channel], buffer);
+	buffer[4] = static_cast<char>(channel);
+	std::memcpy(buffer + kHeaderSize, data, size);
+
+	const auto start = Now();
+	const auto ret = socket.send(buffer, kHeaderSize + size, remote_ip, remote_port);
+	Count(true, ret, start, ret == sf::Socket::Done ? kHeaderSize + size : 0);
+	// a full send buffer just means this datagram is lost, like any other
+	return ret == sf::Socket::NotReady ? sf::Socket::Done : ret;
+}
+
+void Connection::Udp::SendHello()
+{
+	char hello[kMaxDatagramSize - kHeaderSize];
+	std::memcpy(hello, local_nick.data(), local_nick.size());
+	Wire::WriteU32(Protocol::Tag(tick_rate()), hello + local_nick.size());
+	SendDatagram(Hello, hello, local_nick.size() + 4);
+}
+
+bool Connection::Udp::ReadHello(const char* const data, const std::size_t size,
+                                std::string* const nick, sf::Uint32* const tag)
+{
+	if (size < 4)
+		return false;
+
+	nick->assign(data, size - 4);
+	*tag = Wire::ReadU32(data + size - 4);
+	return true;
+}
+
+void Connection::Udp::Poll()
+{
+	char buffer[kMaxDatagramSize];
+	std::size_t received;
+	sf::IpAddress ip;
+	unsigned short port;
+
+	for (;;) {
+		const auto start = Now();
+		const auto ret = socket.receive(buffer, sizeof(buffer), received, ip, port);
+		Count(false, ret, start, ret == sf::Socket::Done ? received : 0);
+		if (ret != sf::Socket::Done)
+			break;
+		if (ip != remote_ip || port != remote_port || received < kHeaderSize)
+			continue;
+
+		const auto seq = Wire::ReadU32(buffer);
+		const auto channel = static_cast<unsigned char>(buffer[4]);
+		if (channel >= ChannelCount)
+			continue;
+
+		last_heard.restart();
+		if (channel == Control) {
+			HandleControl(buffer + kHeaderSize, received - kHeaderSize);
+			continue;
+		} else if (channel == Hello) {
+			// peer didn't get our hello yet
+			SendHello();
+			continue;
+		}
+
+		// drop anything not newer than what we already have, wrap safe
+		if (static_cast<sf::Int32>(seq - receive_seq[channel]) <= 0)
+			continue;
+		receive_seq[channel] = seq;
+
+		std::memcpy(state, buffer + kHeaderSize, received - kHeaderSize);
+		state_size = received - kHeaderSize;
+		has_state = true;
+	}
+}
@@ -0,0 +1,136 @@
+#ifndef PONGON_CONNECTION_HPP_
+#define PONGON_CONNECTION_HPP_
+#include <cstddef>
+
+#include <SFML/Network.hpp>
+
+namespace Connection {
+	enum class Mode {Server, Client};
+	enum class Transport {Tcp, Udp};
+	constexpr const unsigned short kPort {7171};
+	constexpr const std::size_t kMaxPayloadSize {384};
+	// message layout: the id of the chat line being sent, the id of the
+	// last chat line received and the chat line size, followed by the chat
+	// line itself only when there is one, then the payload. over tcp each
+	// message is preceded by its size
+	constexpr const std::size_t kChatHeaderSize {3};
+	constexpr const std::size_t kMaxChatSize {64};
+	constexpr const std::size_t kMaxMessageSize {kChatHeaderSize + kMaxChatSize + kMaxPayloadSize};
+	constexpr const std::size_t kFrameHeaderSize {2};
+	// the network threads of both sides ping each other, at first a few
+	// times in a row and then every second, to measure the round trip and
+	// the offset between their clocks. over tcp a ping or pong goes in a
+	// frame whose size has kControlFrame set, over udp on its own channel.
+	// ping: kind and the sender's time. pong: kind, the ping's time, the
+	// time it arrived and the time the pong left, all in microseconds
+	enum Control : sf::Uint8 {kPing, kPong};
+	constexpr const unsigned kControlFrame {0x8000};
+	constexpr const std::size_t kPingSize {5};
+	constexpr const std::size_t kPongSize {13};
+	constexpr const int kSyncPings {8};
+	constexpr const float kSyncInterval {0.05f};
+	constexpr const float kPingInterval {1.f};
+	// messages queued between the game and the network thread, each way
+	constexpr const std::size_t kQueueSize {64};
+	// how long to wait for the peer, and how many more times a client
+	// tries a server that refused it, a second apart
+	constexpr const float kDefaultTimeout {30.f};
+	constexpr const int kDefaultRetries {10};
+	constexpr const float kRetryInterval {1.f};
+	// how long a dropped tcp connection has to come back, and how long
+	// without a pong it takes to be taken as dropped
+	constexpr const float kReconnectGrace {15.f};
+	constexpr const float kLinkTimeout {3.f};
+	extern sf::TcpSocket socket;
+	extern sf::Socket::Status status;
+	extern Transport transport;
+	extern bool is_server;
+
+	// Init asks for the nick and address and returns right away, the
+	// network thread then connects and owns the socket, the functions
+	// below only go through the queues and never touch it. a client given
+	// a lobby_address gets its server from that Lobby instead of asking.
+	// Handshake is polled until it sets done, once connected and the first
+	// pings are in, or fails
+	bool Init(Mode mode, Transport transport_mode, sf::Time connect_timeout, int connect_retries,
+	          const char* lobby_address);
+	bool Handshake(bool* done);
+	void Close();
+	// a dropped tcp connection is reestablished by the network thread,
+	// with the session token the server handed out, while Reconnecting
+	// tells so. each connection is a new session: the game moves to it
+	// with BeginSession and only messages of that session go through
+	sf::Uint32 Session();
+	void BeginSession();
+	bool Reconnecting();
+	// messages carry the pending chat line along with the payload.
+	// ReceiveMessage gives size 0 when none is ready
+	bool SendMessage(const void* payload, std::size_t size);
+	bool ReceiveMessage(void* payload, std::size_t capacity, std::size_t* size);
+	void PrintStats();
+
+	// the round trip is smoothed like tcp does, with its mean deviation as
+	// the jitter. the offset is taken from the recent ping with the
+	// shortest round trip, the one least skewed by queueing, like ntp does
+	struct Timing {
+		sf::Time rtt;
+		sf::Time min_rtt;
+		sf::Time jitter;
+		// add to our clock to get the peer's
+		sf::Time offset;
+		sf::Uint32 samples;
+	};
+
+	Timing GetTiming();
+
+	// what went through the socket, counted by the network thread and
+	// published to the game every kMetricsInterval seconds. packets are
+	// tcp frames or udp datagrams, and the times the microseconds spent in
+	// the socket calls
+	constexpr const float kMetricsInterval {0.1f};
+	struct Metrics {
+		sf::Uint64 bytes_sent;
+		sf::Uint64 bytes_received;
+		sf::Uint64 packets_sent;
+		sf::Uint64 packets_received;
+		sf::Uint64 sends;
+		sf::Uint64 receives;
+		sf::Int64 send_time;
+		sf::Int64 receive_time;
+		// how the socket calls went, by sf::Socket::Status
+		sf::Uint64 statuses[sf::Socket::Error + 1];
+	};
+
+	// the newest published
+	Metrics GetMetrics();
+	// microseconds on the clock the pings are stamped with
+	sf::Int64 Now();
+	// writes the pong answering ping to dest, returns its size
+	std::size_t WritePong(const char* ping, char* dest);
+	// writes a size prefixed message to dest, returns the bytes written
+	std::size_t WriteMessage(sf::Uint8 chat_id, sf::Uint8 chat_ack,
+	                         const char* chat, std::size_t chat_size,
+	                         const void* payload, std::size_t size, char* dest);
+	void PrintChat();
+
+	// chat lines are kept in fixed buffers, passing them around never
+	// allocates. AppendChat adds what fits of text to line
+	struct ChatLine {
+		std::size_t size;
+		char text[kMaxChatSize];
+	};
+
+	void AppendChat(const char* text, std::size_t size, ChatLine* line);
+
+	// unreliable transport: every datagram carries a per channel sequence
+	// number, stale or duplicated datagrams are dropped and a receive never
+	// waits for a lost one, it just yields the newest state that arrived
+	namespace Udp {
+		bool Connect(const sf::IpAddress& serverIp);
+		void Close();
+		sf::Socket::Status Send(const void* data, std::size_t size);
+		sf::Socket::Status Receive(void* data, std::size_t size, std::size_t& received);
+	}
+}
+
+#endif
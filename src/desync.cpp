@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+#include "connection.hpp"
+#include "desync.hpp"
+#include "game.hpp"
+#include "wire.hpp"
+
+namespace Desync {
+	Stats stats;
+
+	// a state hashed here, frame -1 for none
+	struct Entry {
+		sf::Int32 frame;
+		sf::Uint32 hash;
+		GameState state;
+	};
+
+	static int interval;
+	static Entry local[kHistory];
+	static Check remote[kHistory];
+	// the newest frame hashed here, and the next one to send
+	static sf::Int32 newest;
+	static sf::Int32 next_sent;
+	// the peer's state of the desynced frame was printed
+	static bool dumped;
+
+	static GameState Canonical(const GameState& state);
+	static void Compare(sf::Int32 frame, sf::Uint32 hash);
+	static void Print(const char* side, sf::Int32 frame, const GameState& state);
+}
+
+
+void Desync::Init(const int frames)
+{
+	interval = frames;
+	stats = Stats();
+	stats.desynced = -1;
+	stats.agreed = -1;
+	Restart();
+}
+
+void Desync::Restart()
+{
+	for (auto& entry : local)
+		entry.frame = -1;
+	for (auto& check : remote)
+		check.frame = -1;
+	newest = -1;
+	next_sent = 0;
+}
+
+// fnv-1a over the numbers' exact bits, as write_state sends them
+sf::Uint32 Desync::Hash(const GameState& state)
+{
+	char bytes[kStateSize];
+	write_state(state, bytes);
+	sf::Uint32 bits[kStateSize / 4];
+	for (std::size_t i = 0; i < kStateSize / 4; ++i)
+		bits[i] = Wire::ReadU32(bytes + i * 4);
+	return Schema::Tag(bits);
+}
+
+void Desync::Record(const sf::Int32 frame, const GameState& state)
+{
+	if (interval == 0 || frame % interval != 0 || frame <= newest)
+		return;
+
+	auto& entry = local[(frame / interval) % kHistory];
+	entry.frame = frame;
+	entry.state = Canonical(state);
+	entry.hash = Hash(entry.state);
+	newest = frame;
+
+	const auto& check = remote[(frame / interval) % kHistory];
+	if (check.frame == frame)
+		Compare(frame, check.hash);
+}
+
+// a message carries one hash, the next in frame order, so none is
+// skipped when several frames are hashed at once, unless it falls out of
+// the history. caught up, the newest goes again. once out of sync the
+// state of that frame goes as well
+void Desync::Write(Wire::Writer* const writer)
+{
+	if (interval == 0) {
+		Wire::Write(writer, 0, 2);
+		return;
+	}
+
+	next_sent = std::max(next_sent, newest - (kHistory - 1) * interval);
+	const auto sent = std::min(next_sent, newest);
+	const auto& check = local[(std::max(sent, 0) / interval) % kHistory];
+	const auto& desynced = local[(std::max(stats.desynced, 0) / interval) % kHistory];
+	const bool has_check = sent >= 0;
+	const bool has_dump = stats.desynced >= 0 && desynced.frame == stats.desynced;
+	Wire::Write(writer, has_check, 1);
+	Wire::Write(writer, has_dump, 1);
+	if (has_check) {
+		CheckSchema::Write(writer, Check {check.frame, check.hash});
+		next_sent = std::min(next_sent, newest) + interval;
+	}
+	if (has_dump)
+		DumpSchema::Write(writer, Dump {desynced.frame, desynced.state});
+}
+
+// the frames go as their low bits, expanded against the newest hashed
+void Desync::Read(Wire::Reader* const reader, Tail* const tail)
+{
+	tail->has_check = Wire::Read(reader, 1) != 0;
+	tail->has_dump = Wire::Read(reader, 1) != 0;
+	if (tail->has_check) {
+		CheckSchema::Read(reader, &tail->check);
+		tail->check.frame = Wire::Expand(static_cast<sf::Uint32>(tail->check.frame), newest);
+	}
+	if (tail->has_dump) {
+		DumpSchema::Read(reader, &tail->dump);
+		tail->dump.frame = Wire::Expand(static_cast<sf::Uint32>(tail->dump.frame), newest);
+	}
+}
+
+void Desync::Receive(const Tail& tail)
+{
+	if (interval == 0)
+		return;
+
+	// the same hash comes in several messages, it is compared once
+	const auto& check = tail.check;
+	auto& received = remote[(std::max(check.frame, 0) / interval) % kHistory];
+	if (tail.has_check && check.frame >= 0 && check.frame % interval == 0 && received.frame != check.frame) {
+		received = check;
+		if (local[(check.frame / interval) % kHistory].frame == check.frame)
+			Compare(check.frame, check.hash);
+	}
+
+	// the peer may have found it first, its hash of the frame got lost
+	if (tail.has_dump && !dumped && tail.dump.frame >= 0 && tail.dump.frame % interval == 0) {
+		const auto& dump = tail.dump;
+		const auto& entry = local[(dump.frame / interval) % kHistory];
+		if (stats.desynced < 0 && entry.frame == dump.frame)
+			Compare(dump.frame, Hash(dump.state));
+		if (dump.frame == stats.desynced) {
+			Print("theirs", dump.frame, dump.state);
+			dumped = true;
+		}
+	}
+}
+
+void Desync::PrintStats()
+{
+	if (interval == 0)
+		return;
+
+	std::cout << "desync check: " << stats.checked << " frames compared";
+	if (stats.desynced >= 0)
+		std::cout << ", out of sync at frame " << stats.desynced << ", last in sync at frame " << stats.agreed;
+	else
+		std::cout << ", all in sync";
+	std::cout << '\n';
+}
+
+// the server's paddle is the left one
+GameState Desync::Canonical(const GameState& state)
+{
+	auto canonical = state;
+	if (!Connection::is_server)
+		std::swap(canonical.local, canonical.remote);
+	return canonical;
+}
+
+// the hashes keep being compared after the first mismatch, only that one
+// is reported, a resync included
+void Desync::Compare(const sf::Int32 frame, const sf::Uint32 hash)
+{
+	++stats.checked;
+	const auto& entry = local[(frame / interval) % kHistory];
+	if (stats.desynced >= 0) {
+		return;
+	} else if (entry.hash == hash) {
+		stats.agreed = std::max(stats.agreed, frame);
+		return;
+	}
+
+	stats.desynced = frame;
+	std::cerr << "desync: the peers' states differ at frame " << frame
+	          << ", last in sync at frame " << stats.agreed << '\n';
+	Print("ours", frame, entry.state);
+}
+
+void Desync::Print(const char* const side, const sf::Int32 frame, const GameState& state)
+{
+	std::cerr << std::setprecision(9) << "desync: " << side << " at frame " << frame
+	          << ": ball " << to_float(state.ball.x) << ' ' << to_float(state.ball.y)
+	          << " velocity " << to_float(state.ball_velocity.x) << ' ' << to_float(state.ball_velocity.y)
+	          << ", left paddle " << to_float(state.local.y) << ", right paddle " << to_float(state.remote.y)
+	          << ", hash " << std::hex << Hash(state) << std::dec << '\n'
+	          << std::setprecision(6);
+}
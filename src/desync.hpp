@@ -0,0 +1,72 @@
+#ifndef PONGON_DESYNC_HPP_
+#define PONGON_DESYNC_HPP_
+#include <SFML/System.hpp>
+
+#include "game.hpp"
+#include "schema.hpp"
+
+// the netcodes simulating the ball on both sides from the inputs alone,
+// -delay and -rollback, can check the two still agree. every interval
+// frames each side hashes the state the frame starts from, once no
+// rollback can change it, seen from the left paddle's side so both hash
+// the same thing, and sends the hashes one at a time at the end of its
+// inputs messages. the first frame whose hashes differ is reported, then
+// both sides send their state of that frame so each prints the two
+namespace Desync {
+	constexpr const int kMaxInterval {600};
+	// hashes kept of each side, waiting for the other's
+	constexpr const int kHistory {64};
+
+	struct Check {
+		sf::Int32 frame;
+		sf::Uint32 hash;
+	};
+
+	struct Dump {
+		sf::Int32 frame;
+		GameState state;
+	};
+
+	// the tail of an inputs message: a bit telling if a check follows, and
+	// another if a dump does. they are always there, so peers with and
+	// without checks still understand each other
+	using CheckSchema = Schema::Struct<
+		PONGON_FIELD(Check::frame, Schema::Unsigned<Wire::kFrameBits>),
+		PONGON_FIELD(Check::hash, Schema::Unsigned<32>)>;
+	using DumpSchema = Schema::Struct<
+		PONGON_FIELD(Dump::frame, Schema::Unsigned<Wire::kFrameBits>),
+		PONGON_FIELD(Dump::state, StateSchema)>;
+	constexpr const int kMaxBits {2 + CheckSchema::kBits + DumpSchema::kBits};
+
+	struct Tail {
+		bool has_check;
+		bool has_dump;
+		Check check;
+		Dump dump;
+	};
+
+	struct Stats {
+		sf::Uint32 checked;
+		// the first frame found out of sync, and the last one in sync
+		// before it, -1 for none
+		sf::Int32 desynced;
+		sf::Int32 agreed;
+	};
+
+	extern Stats stats;
+
+	// interval 0 checks nothing
+	void Init(int interval);
+	// frames start from 0 again, after a resync
+	void Restart();
+	sf::Uint32 Hash(const GameState& state);
+	// state: what frame starts from, from this side's view
+	void Record(sf::Int32 frame, const GameState& state);
+	void Write(Wire::Writer* writer);
+	void Read(Wire::Reader* reader, Tail* tail);
+	// once the message it came in turned out well formed
+	void Receive(const Tail& tail);
+	void PrintStats();
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef PONGON_FIXED_POINT_HPP_
+#define PONGON_FIXED_POINT_HPP_
+#include <SFML/System.hpp>
+
+// a number kept as an integer count of 1 / 2^FracBits. every operation is
+// a plain integer one, so it comes out the same whatever the compiler,
+// its optimizations or the cpu. the count is 64 bits, so squared
+// distances don't overflow. multiplying and dividing truncate toward
+// zero. converting from a float scales it by a power of two, which is
+// exact, and rounds half away from zero
+template<int FracBits>
+class FixedPoint {
+	static_assert(FracBits > 0 && FracBits < 31, "fraction bits must leave room for products");
+
+public:
+	static constexpr int kFracBits {FracBits};
+
+	// left as it is like a float's, {} makes it 0
+	FixedPoint() = default;
+
+	static constexpr FixedPoint FromRaw(const sf::Int64 raw)
+	{
+		return FixedPoint(raw);
+	}
+
+	static constexpr FixedPoint FromFloat(const float value)
+	{
+		return FixedPoint(static_cast<sf::Int64>(value * kOne + (value < 0 ? -0.5f : 0.5f)));
+	}
+
+	// exact as long as the raw value fits a float's 24 bit mantissa
+	constexpr float ToFloat() const
+	{
+		return static_cast<float>(raw) / kOne;
+	}
+
+	constexpr sf::Int64 Raw() const
+	{
+		return raw;
+	}
+
+	constexpr FixedPoint operator-() const { return FixedPoint(-raw); }
+	constexpr FixedPoint operator+(const FixedPoint other) const { return FixedPoint(raw + other.raw); }
+	constexpr FixedPoint operator-(const FixedPoint other) const { return FixedPoint(raw - other.raw); }
+	constexpr FixedPoint operator*(const FixedPoint other) const { return FixedPoint(raw * other.raw / kRawOne); }
+	constexpr FixedPoint operator/(const FixedPoint other) const { return FixedPoint(raw * kRawOne / other.raw); }
+	FixedPoint& operator+=(const FixedPoint other) { raw += other.raw; return *this; }
+	FixedPoint& operator-=(const FixedPoint other) { raw -= other.raw; return *this; }
+	constexpr bool operator==(const FixedPoint other) const { return raw == other.raw; }
+	constexpr bool operator!=(const FixedPoint other) const { return raw != other.raw; }
+	constexpr bool operator<(const FixedPoint other) const { return raw < other.raw; }
+	constexpr bool operator<=(const FixedPoint other) const { return raw <= other.raw; }
+	constexpr bool operator>(const FixedPoint other) const { return raw > other.raw; }
+	constexpr bool operator>=(const FixedPoint other) const { return raw >= other.raw; }
+
+	friend constexpr FixedPoint abs(const FixedPoint value)
+	{
+		return FixedPoint(value.raw < 0 ? -value.raw : value.raw);
+	}
+
+	// rounded down, bit by bit
+	friend FixedPoint sqrt(const FixedPoint value)
+	{
+		if (value.raw <= 0)
+			return FixedPoint(0);
+
+		auto scaled = static_cast<sf::Uint64>(value.raw) << FracBits;
+		sf::Uint64 root {0};
+		sf::Uint64 bit {sf::Uint64(1) << 62};
+		while (bit > scaled)
+			bit >>= 2;
+		while (bit != 0) {
+			if (scaled >= root + bit) {
+				scaled -= root + bit;
+				root = (root >> 1) + bit;
+			} else {
+				root >>= 1;
+			}
+			bit >>= 2;
+		}
+		return FixedPoint(static_cast<sf::Int64>(root));
+	}
+
+private:
+	static constexpr sf::Int64 kRawOne {sf::Int64(1) << FracBits};
+	static constexpr float kOne {static_cast<float>(kRawOne)};
+
+	constexpr explicit FixedPoint(const sf::Int64 value) : raw(value) {}
+
+	sf::Int64 raw;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#include "game.hpp"
+
+void update_shapes(const GameState& state, Shapes* const shapes)
+{
+	shapes->ball.setPosition(to_float(state.ball.x), to_float(state.ball.y));
+	shapes->local.setPosition(to_float(state.local.x), to_float(state.local.y));
+	shapes->remote.setPosition(to_float(state.remote.x), to_float(state.remote.y));
+}
+
+std::size_t write_state(const GameState& state, char* const dest)
+{
+	return StateSchema::Encode(state, dest);
+}
+
+bool read_state(const char* const src, const std::size_t size, GameState* const state)
+{
+	if (!StateSchema::Decode(src, size, state))
+		return false;
+
+	state->local.velocity = to_scalar(0.f);
+	state->remote.velocity = to_scalar(0.f);
+	return true;
+}
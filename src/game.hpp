@@ -0,0 +1,49 @@
+#ifndef PONGON_GAME_HPP_
+#define PONGON_GAME_HPP_
+#include <SFML/Graphics.hpp>
+
+#include "schema.hpp"
+#include "simulation.hpp"
+
+struct BallShape : sf::CircleShape {
+	BallShape() : sf::CircleShape(kBallRadius) {
+		setOrigin(kBallRadius, kBallRadius);
+		setFillColor(sf::Color::Green);
+		setOutlineColor(sf::Color::Magenta);
+	}
+};
+
+struct PaddleShape : sf::RectangleShape {
+	PaddleShape() : sf::RectangleShape({kPaddleWidth, kPaddleHeight}) {
+		setOrigin(kPaddleWidth / 2, kPaddleHeight / 2);
+		setFillColor(sf::Color::Red);
+		setOutlineColor(sf::Color::Green);
+	}
+};
+
+// what the window draws, placed from a GameState before each frame
+struct Shapes {
+	BallShape ball;
+	PaddleShape local;
+	PaddleShape remote;
+};
+
+// a state's numbers exactly, see Schema::Exact: the ball's position and
+// velocity, then the paddles' y. the frame, the paddles' x and velocities stay
+// behind, the receiver has its own
+using VectorSchema = Schema::Struct<
+	PONGON_FIELD(Vector::x, Schema::Exact),
+	PONGON_FIELD(Vector::y, Schema::Exact)>;
+using StateSchema = Schema::Struct<
+	PONGON_FIELD(GameState::ball, VectorSchema),
+	PONGON_FIELD(GameState::ball_velocity, VectorSchema),
+	PONGON_FIELD(GameState::local, Schema::Struct<PONGON_FIELD(PaddleState::y, Schema::Exact)>),
+	PONGON_FIELD(GameState::remote, Schema::Struct<PONGON_FIELD(PaddleState::y, Schema::Exact)>)>;
+constexpr const std::size_t kStateSize {StateSchema::kMaxSize};
+
+void update_shapes(const GameState& state, Shapes* shapes);
+std::size_t write_state(const GameState& state, char* dest);
+// only what write_state wrote is replaced, the paddle velocities are zeroed
+bool read_state(const char* src, std::size_t size, GameState* state);
+
+#endif
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <iostream>
+
+#include "connection.hpp"
+#include "hud.hpp"
+
+namespace Hud {
+	enum Bar {
+		kSentRate, kReceivedRate, kSentPackets, kReceivedPackets, kSentPerFrame,
+		kReceivedPerFrame, kSendTime, kReceiveTime, kRoundTrip, kFailed, kBarCount
+	};
+
+	// full: the value filling the bar, past it the bar turns red
+	struct BarInfo {
+		const char* name;
+		const char* unit;
+		float full;
+		sf::Color color;
+	};
+
+	// sent in white, received in yellow
+	static const BarInfo bars[kBarCount] {
+		{"sent", " B/s", 4096.f, sf::Color::White},
+		{"received", " B/s", 4096.f, sf::Color::Yellow},
+		{"packets sent", "/s", 180.f, sf::Color::White},
+		{"packets received", "/s", 180.f, sf::Color::Yellow},
+		{"sent a frame", " B", 64.f, sf::Color::White},
+		{"received a frame", " B", 64.f, sf::Color::Yellow},
+		{"send call", " us", 500.f, sf::Color::Cyan},
+		{"receive call", " us", 500.f, sf::Color::Cyan},
+		{"round trip", " ms", 200.f, sf::Color::Magenta},
+		{"failed calls", "", 10.f, sf::Color::Red}
+	};
+
+	constexpr const float kMargin {8.f};
+	constexpr const float kBarWidth {128.f};
+	constexpr const float kBarHeight {4.f};
+	constexpr const float kBarSpacing {7.f};
+
+	// the metrics at one end of a span, time in Connection::Now microseconds
+	struct Sample {
+		Connection::Metrics metrics;
+		sf::Uint32 frames;
+		sf::Int64 time;
+	};
+
+	static bool visible;
+	static bool legend_printed;
+	static float dump_interval;
+	static Sample last_sample;
+	static Sample last_dump;
+	static float values[kBarCount];
+	static sf::RectangleShape background;
+	static sf::RectangleShape bar;
+
+	static void Measure(const Sample& from, const Sample& to, float* values);
+	static void Dump(const float* values);
+}
+
+
+void Hud::Init(const bool show, const float dump_seconds)
+{
+	visible = show;
+	dump_interval = dump_seconds;
+	last_sample = {Connection::GetMetrics(), 0, Connection::Now()};
+	last_dump = last_sample;
+	std::fill(values, values + kBarCount, 0.f);
+	background.setPosition(kMargin / 2, kMargin / 2);
+	background.setSize({kBarWidth + kMargin, kBarCount * kBarSpacing + kMargin});
+	background.setFillColor(sf::Color(0, 0, 0, 128));
+	if (visible)
+		PrintLegend();
+}
+
+void Hud::Toggle()
+{
+	visible = !visible;
+	if (visible && !legend_printed)
+		PrintLegend();
+}
+
+void Hud::Update(const sf::Uint32 frames)
+{
+	const Sample now {Connection::GetMetrics(), frames, Connection::Now()};
+	if (now.time - last_sample.time >= sf::seconds(kSampleInterval).asMicroseconds()) {
+		Measure(last_sample, now, values);
+		last_sample = now;
+	}
+
+	if (dump_interval > 0 && now.time - last_dump.time >= sf::seconds(dump_interval).asMicroseconds()) {
+		float dumped[kBarCount];
+		Measure(last_dump, now, dumped);
+		Dump(dumped);
+		last_dump = now;
+	}
+}
+
+void Hud::Draw(sf::RenderTarget* const target)
+{
+	if (!visible)
+		return;
+
+	target->draw(background);
+	for (int i = 0; i < kBarCount; ++i) {
+		const auto fill = values[i] / bars[i].full;
+		bar.setPosition(kMargin, kMargin + i * kBarSpacing);
+		bar.setSize({kBarWidth, kBarHeight});
+		bar.setFillColor(sf::Color(64, 64, 64));
+		target->draw(bar);
+		bar.setSize({kBarWidth * std::min(fill, 1.f), kBarHeight});
+		bar.setFillColor(fill > 1.f ? sf::Color::Red : bars[i].color);
+		target->draw(bar);
+	}
+}
+
+void Hud::PrintLegend()
+{
+	legend_printed = true;
+	std::clog << "hud (" << kSampleInterval << " s), from the top:";
+	for (const auto& info : bars)
+		std::clog << ' ' << info.name << " (full at " << info.full << info.unit << ')';
+	std::clog << '\n';
+}
+
+void Hud::Measure(const Sample& from, const Sample& to, float* const values)
+{
+	const auto& a = from.metrics;
+	const auto& b = to.metrics;
+	const auto seconds = std::max((to.time - from.time) / 1e6f, 1e-6f);
+	const auto frames = static_cast<float>(std::max<sf::Uint32>(to.frames - from.frames, 1));
+	const auto sends = static_cast<float>(std::max<sf::Uint64>(b.sends - a.sends, 1));
+	const auto receives = static_cast<float>(std::max<sf::Uint64>(b.receives - a.receives, 1));
+	sf::Uint64 failed = 0;
+	for (const auto status : {sf::Socket::Partial, sf::Socket::Disconnected, sf::Socket::Error})
+		failed += b.statuses[status] - a.statuses[status];
+
+	values[kSentRate] = (b.bytes_sent - a.bytes_sent) / seconds;
+	values[kReceivedRate] = (b.bytes_received - a.bytes_received) / seconds;
+	values[kSentPackets] = (b.packets_sent - a.packets_sent) / seconds;
+	values[kReceivedPackets] = (b.packets_received - a.packets_received) / seconds;
+	values[kSentPerFrame] = (b.bytes_sent - a.bytes_sent) / frames;
+	values[kReceivedPerFrame] = (b.bytes_received - a.bytes_received) / frames;
+	values[kSendTime] = (b.send_time - a.send_time) / sends;
+	values[kReceiveTime] = (b.receive_time - a.receive_time) / receives;
+	values[kRoundTrip] = Connection::GetTiming().rtt.asMicroseconds() / 1000.f;
+	values[kFailed] = static_cast<float>(failed);
+}
+
+void Hud::Dump(const float* const values)
+{
+	std::clog << "net:";
+	for (int i = 0; i < kBarCount; ++i)
+		std::clog << (i > 0 ? ", " : " ") << bars[i].name << ' ' << values[i] << bars[i].unit;
+	std::clog << '\n';
+}
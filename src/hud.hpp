@@ -0,0 +1,22 @@
+#ifndef PONGON_HUD_HPP_
+#define PONGON_HUD_HPP_
+#include <SFML/Graphics.hpp>
+
+// the connection's metrics over the last kSampleInterval seconds, drawn as
+// bars over the game, there being no font to write them with, and dumped
+// to the log every so often. PrintLegend tells what each bar is and the
+// value that fills it
+namespace Hud {
+	constexpr const float kSampleInterval {0.5f};
+	constexpr const sf::Keyboard::Key kToggleKey {sf::Keyboard::F3};
+
+	// dump_interval in seconds, 0 for no dumps
+	void Init(bool visible, float dump_interval);
+	void Toggle();
+	// frames: how many the netcode simulated so far
+	void Update(sf::Uint32 frames);
+	void Draw(sf::RenderTarget* target);
+	void PrintLegend();
+}
+
+#endif
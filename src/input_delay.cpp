@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <iostream>
+
+#include "connection.hpp"
+#include "desync.hpp"
+#include "input_queue.hpp"
+#include "input_delay.hpp"
+#include "replay.hpp"
+
+namespace InputDelay {
+	Stats stats;
+
+	// while stalled the inputs are resent in case the last message was lost
+	constexpr const float kResendInterval {1.f / 60.f};
+	static int delay_frames;
+	static sf::Int32 frame;
+	// the input for this frame is queued already
+	static bool pushed;
+	static bool stalling;
+	static sf::Clock stall_clock;
+	static sf::Clock resend_clock;
+
+	template<class Condition>
+	static bool Stall(Condition done);
+}
+
+
+void InputDelay::Init(const int delay)
+{
+	delay_frames = std::max(0, std::min(delay, kMaxDelay));
+	stats = Stats();
+	Restart();
+}
+
+void InputDelay::Restart()
+{
+	frame = 0;
+	pushed = false;
+	stalling = false;
+	InputQueue::Init();
+	Desync::Restart();
+
+	// the first frames have no input scheduled for them
+	for (int i = 0; i < delay_frames; ++i)
+		InputQueue::Push(0.f);
+}
+
+bool InputDelay::Update(const float local_input, GameState* const state)
+{
+	if (!InputQueue::Receive())
+		return false;
+
+	if (!pushed) {
+		// the peer is too far behind acknowledging our inputs to take more
+		if (InputQueue::Full()) {
+			if (!Stall([] { return !InputQueue::Full(); }))
+				return false;
+			else if (InputQueue::Full())
+				return true;
+		}
+
+		InputQueue::Push(local_input);
+		if (!InputQueue::Send(frame - (InputQueue::confirmed + 1)))
+			return false;
+		pushed = true;
+	}
+
+	// the queue ran empty, nothing to do but wait for the remote input
+	if (frame > InputQueue::confirmed) {
+		if (!Stall([] { return frame <= InputQueue::confirmed; }))
+			return false;
+		else if (frame > InputQueue::confirmed)
+			return true;
+	}
+
+	Desync::Record(frame, *state);
+	Replay::Record(InputQueue::Local(frame), InputQueue::Remote(frame), &Replay::recorder);
+	step({InputQueue::Local(frame), InputQueue::Remote(frame)}, state);
+	pushed = false;
+	++frame;
+	++stats.frames;
+	return true;
+}
+
+void InputDelay::PrintStats()
+{
+	std::cout << "input delay: " << stats.frames << " frames, "
+	          << stats.stalls << " stalls, "
+	          << stats.stalled.asMilliseconds() << " ms stalled, "
+	          << stats.longest_stall.asMilliseconds() << " ms longest stall\n";
+}
+
+// false only on a connection error, the caller checks if it is done. a
+// stall polls once and goes on in the next update, the window is not held
+template<class Condition>
+bool InputDelay::Stall(const Condition done)
+{
+	if (!stalling) {
+		stalling = true;
+		++stats.stalls;
+		stall_clock.restart();
+		resend_clock.restart();
+	}
+
+	if (!done()) {
+		if (resend_clock.getElapsedTime().asSeconds() > kResendInterval) {
+			if (!InputQueue::Send(frame - (InputQueue::confirmed + 1)))
+				return false;
+			resend_clock.restart();
+		}
+		if (!InputQueue::Receive())
+			return false;
+	}
+
+	if (done()) {
+		const auto stalled = stall_clock.getElapsedTime();
+		stalling = false;
+		stats.stalled += stalled;
+		stats.longest_stall = std::max(stats.longest_stall, stalled);
+	}
+	return true;
+}
@@ -0,0 +1,31 @@
+#ifndef PONGON_INPUT_DELAY_HPP_
+#define PONGON_INPUT_DELAY_HPP_
+#include <SFML/System.hpp>
+
+#include "simulation.hpp"
+
+// lockstep where the local input is applied a few frames after it is
+// read. it is sent right away, so by the time its frame is simulated the
+// remote input for it has usually arrived and the loop doesn't wait.
+// both peers must run with the same delay
+namespace InputDelay {
+	constexpr const int kMaxDelay {15};
+	constexpr const int kDefaultDelay {3};
+
+	struct Stats {
+		sf::Uint32 frames;
+		sf::Uint32 stalls;
+		sf::Time stalled;
+		sf::Time longest_stall;
+	};
+
+	extern Stats stats;
+
+	void Init(int delay);
+	// goes back to frame 0 from the current state, after a resync
+	void Restart();
+	bool Update(float local_input, GameState* state);
+	void PrintStats();
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include <cassert>
+#include <algorithm>
+
+#include "connection.hpp"
+#include "desync.hpp"
+#include "input_queue.hpp"
+#include "wire.hpp"
+
+namespace InputQueue {
+	sf::Int32 local_end;
+	sf::Int32 confirmed;
+	sf::Int32 peer_confirmed;
+	sf::Int32 remote_advantage;
+
+	static_assert(kMaxUnacked < (1 << kCountBits), "the input count must fit its bits");
+	static_assert((HeaderSchema::kBits + kMaxUnacked * Wire::kInputBits + Desync::kMaxBits + 7) / 8 <=
+	              Connection::kMaxPayloadSize, "unacknowledged inputs must fit in one message");
+	static float local_inputs[kSize];
+	static float remote_inputs[kSize];
+}
+
+
+void InputQueue::Init()
+{
+	local_end = 0;
+	confirmed = -1;
+	peer_confirmed = -1;
+	remote_advantage = 0;
+}
+
+bool InputQueue::Full()
+{
+	return local_end - peer_confirmed > kMaxUnacked;
+}
+
+void InputQueue::Push(const float input)
+{
+	assert(!Full());
+	local_inputs[local_end++ % kSize] = input;
+}
+
+float InputQueue::Local(const sf::Int32 frame)
+{
+	assert(frame >= 0 && frame < local_end && local_end - frame <= kSize);
+	return local_inputs[frame % kSize];
+}
+
+float InputQueue::Remote(const sf::Int32 frame)
+{
+	assert(frame >= 0 && frame <= confirmed && confirmed - frame < kSize);
+	return remote_inputs[frame % kSize];
+}
+
+bool InputQueue::Send(const sf::Int32 advantage)
+{
+	char payload[Connection::kMaxPayloadSize];
+	const auto first = peer_confirmed + 1;
+	const auto count = local_end - first;
+
+	Wire::Writer writer {payload, sizeof(payload), 0};
+	HeaderSchema::Write(&writer, Header {confirmed, first, count, std::max(-128, std::min(advantage, 127))});
+	for (sf::Int32 i = 0; i < count; ++i)
+		Wire::WriteInput(&writer, local_inputs[(first + i) % kSize]);
+	Desync::Write(&writer);
+
+	return Connection::SendMessage(payload, Wire::Size(writer));
+}
+
+bool InputQueue::Receive()
+{
+	char payload[Connection::kMaxPayloadSize];
+	std::size_t size;
+
+	for (;;) {
+		if (!Connection::ReceiveMessage(payload, sizeof(payload), &size))
+			return false;
+		else if (size == 0)
+			return true;
+
+		// the frames are expanded against the closest ones we know of
+		Wire::Reader reader {payload, size, 0, false};
+		Header header;
+		HeaderSchema::Read(&reader, &header);
+		const auto ack = Wire::Expand(static_cast<sf::Uint32>(header.ack), local_end - 1);
+		const auto first = Wire::Expand(static_cast<sf::Uint32>(header.first), confirmed + 1);
+		const auto count = header.count;
+		const auto advantage = header.advantage;
+		// the desync check tail follows the inputs
+		const auto inputs_bits = static_cast<std::size_t>(HeaderSchema::kBits + count * Wire::kInputBits);
+		Wire::Reader tail_reader {payload, size, inputs_bits, false};
+		Desync::Tail tail;
+		Desync::Read(&tail_reader, &tail);
+		if (reader.overflow || tail_reader.overflow || size != (tail_reader.bits + 7) / 8)
+			continue;
+
+		peer_confirmed = std::max(peer_confirmed, std::min(ack, local_end - 1));
+		remote_advantage = advantage;
+		Desync::Receive(tail);
+		if (first > confirmed + 1)
+			continue;
+
+		for (sf::Int32 i = 0; i < count; ++i) {
+			const auto input = Wire::ReadInput(&reader);
+			if (first + i > confirmed) {
+				remote_inputs[(first + i) % kSize] = input;
+				confirmed = first + i;
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef PONGON_INPUT_QUEUE_HPP_
+#define PONGON_INPUT_QUEUE_HPP_
+#include <SFML/System.hpp>
+
+#include "schema.hpp"
+
+// paddle inputs keyed by frame number. every message resends the local
+// inputs the peer has not acknowledged yet, so a lost one is recovered by
+// the next, and remote inputs are confirmed in frame order
+namespace InputQueue {
+	constexpr const sf::Int32 kSize {64};
+	constexpr const sf::Int32 kMaxUnacked {kSize / 2};
+	// frames [0, local_end) have a local input
+	extern sf::Int32 local_end;
+	// frames [0, confirmed] have a remote input
+	extern sf::Int32 confirmed;
+	// frames [0, peer_confirmed] of our inputs reached the peer
+	extern sf::Int32 peer_confirmed;
+	// how many frames the peer is ahead of the inputs it has from us
+	extern sf::Int32 remote_advantage;
+
+	// inputs message: the ack and first frame as their low bits, the input
+	// count and the frame advantage, then the local inputs not yet
+	// acknowledged by the peer, 2 bits each, then Desync's tail
+	struct Header {
+		sf::Int32 ack;
+		sf::Int32 first;
+		sf::Int32 count;
+		sf::Int32 advantage;
+	};
+
+	constexpr const int kCountBits {6};
+	constexpr const int kAdvantageBits {8};
+	using HeaderSchema = Schema::Struct<
+		PONGON_FIELD(Header::ack, Schema::Unsigned<Wire::kFrameBits>),
+		PONGON_FIELD(Header::first, Schema::Unsigned<Wire::kFrameBits>),
+		PONGON_FIELD(Header::count, Schema::Unsigned<kCountBits>),
+		PONGON_FIELD(Header::advantage, Schema::Signed<kAdvantageBits>)>;
+
+	void Init();
+	bool Full();
+	void Push(float input);
+	float Local(sf::Int32 frame);
+	float Remote(sf::Int32 frame);
+	bool Send(sf::Int32 advantage);
+	bool Receive();
+}
+
+#endif
@@ -0,0 +1,115 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+#include "interpolation.hpp"
+
+namespace Interpolation {
+	Stats stats;
+
+	struct Snapshot {
+		sf::Int32 time;
+		float y;
+	};
+
+	// smoothing gains as in rfc 3550's jitter estimate. the transit time
+	// floor creeps up slowly so it follows the two clocks drifting apart
+	constexpr const float kGain {1.f / 16.f};
+	constexpr const float kFloorDrift {0.01f};
+	static Snapshot buffer[kBufferSize];
+	static int count;
+	static sf::Clock clock;
+	static bool has_floor;
+	static float transit_floor;
+	static float interval;
+}
+
+
+void Interpolation::Init()
+{
+	count = 0;
+	has_floor = false;
+	interval = 1000.f / 60.f;
+	stats = Stats();
+	clock.restart();
+}
+
+sf::Int32 Interpolation::Now()
+{
+	return clock.getElapsedTime().asMilliseconds();
+}
+
+void Interpolation::Push(const sf::Int32 time, const float y)
+{
+	// late or duplicated
+	if (count > 0 && time <= buffer[count - 1].time)
+		return;
+
+	const auto transit = static_cast<float>(Now() - time);
+	if (!has_floor || transit < transit_floor) {
+		transit_floor = transit;
+		has_floor = true;
+	} else {
+		transit_floor += kFloorDrift;
+	}
+
+	stats.jitter += (transit - transit_floor - stats.jitter) * kGain;
+	if (count > 0)
+		interval += (static_cast<float>(time - buffer[count - 1].time) - interval) * kGain;
+
+	if (count == kBufferSize) {
+		std::memmove(buffer, buffer + 1, (kBufferSize - 1) * sizeof(Snapshot));
+		--count;
+	}
+
+	buffer[count++] = {time, y};
+}
+
+bool Interpolation::Sample(float* const y)
+{
+	if (count == 0)
+		return false;
+
+	stats.delay = std::max(kMinDelay, std::min(interval + 2.f * stats.jitter, kMaxDelay));
+	const auto render_time = static_cast<float>(Now()) - transit_floor - stats.delay;
+
+	// only the last snapshot before the render time is still needed
+	int first = 0;
+	while (first + 1 < count && buffer[first + 1].time <= render_time)
+		++first;
+	if (first > 0) {
+		count -= first;
+		std::memmove(buffer, buffer + first, count * sizeof(Snapshot));
+	}
+
+	++stats.samples;
+	stats.depth = 0;
+	for (int i = count; i > 0 && buffer[i - 1].time > render_time; --i)
+		++stats.depth;
+	stats.max_depth = std::max(stats.max_depth, stats.depth);
+
+	const auto& from = buffer[0];
+	if (render_time <= from.time) {
+		*y = from.y;
+	} else if (count == 1) {
+		// ran out of snapshots, hold the newest until more arrive
+		*y = from.y;
+		++stats.underruns;
+	} else {
+		const auto& to = buffer[1];
+		const auto t = (render_time - from.time) / static_cast<float>(to.time - from.time);
+		*y = from.y + (to.y - from.y) * t;
+	}
+
+	return true;
+}
+
+void Interpolation::PrintStats()
+{
+	std::cout << "interpolation: " << stats.samples << " samples, "
+	          << stats.underruns << " underruns, "
+	          << stats.max_depth << " max depth, "
+	          << stats.delay << " ms delay, "
+	          << stats.jitter << " ms jitter\n";
+}
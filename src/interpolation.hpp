@@ -0,0 +1,34 @@
+#ifndef PONGON_INTERPOLATION_HPP_
+#define PONGON_INTERPOLATION_HPP_
+#include <SFML/System.hpp>
+
+// remote paddle positions stamped with the sender's clock. the paddle is
+// placed a small interval in the past, between the two snapshots around
+// it, so snapshots arriving unevenly don't make it stutter. the interval
+// follows the send rate and the jitter measured on arrival
+namespace Interpolation {
+	constexpr const float kMinDelay {10.f};
+	constexpr const float kMaxDelay {250.f};
+	constexpr const int kBufferSize {32};
+
+	struct Stats {
+		sf::Uint32 samples;
+		sf::Uint32 underruns;
+		// snapshots buffered ahead of the time being shown
+		sf::Uint32 depth;
+		sf::Uint32 max_depth;
+		// milliseconds behind the newest snapshot
+		float delay;
+		float jitter;
+	};
+
+	extern Stats stats;
+
+	void Init();
+	sf::Int32 Now();
+	void Push(sf::Int32 time, float y);
+	bool Sample(float* y);
+	void PrintStats();
+}
+
+#endif
@@ -0,0 +1,668 @@
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <SFML/Network.hpp>
+
+#include "connection.hpp"
+#include "lobby.hpp"
+#include "poller.hpp"
+#include "protocol.hpp"
+#include "wire.hpp"
+
+namespace Lobby {
+	// leaving: handed its ticket, kept until it hangs up so the ticket
+	// isn't lost to a reset
+	enum class State {Hello, Measuring, Queued, Leaving, Closed};
+
+	constexpr const std::size_t kRxSize {2 * (Connection::kFrameHeaderSize + kMaxMessageSize)};
+	constexpr const std::size_t kTxSize {64};
+	constexpr const std::size_t kHelloSize {5};
+	constexpr const std::size_t kTicketSize {1 + TicketSchema::kMaxSize};
+	// how long a player may take to say hello and answer the pings, and
+	// to hang up once it has its ticket
+	constexpr const float kHelloTimeout {10.f};
+	constexpr const float kLeaveTimeout {5.f};
+	constexpr const float kSimulateTimeout {60.f};
+	static_assert(kTicketSize <= kMaxMessageSize && Connection::kPongSize <= kMaxMessageSize,
+	              "the messages must fit");
+
+	struct Player;
+	// by the shortest round trip, in microseconds
+	using Queue = std::multimap<sf::Int64, Player*>;
+
+	struct Player {
+		Poller::Socket socket;
+		State state {State::Hello};
+		int pongs {0};
+		sf::Int64 rtt {0};
+		// when it got to its state, on Connection::Now
+		sf::Int64 since {0};
+		Queue::iterator slot;
+		// waiting in the flushing list
+		bool flushing {false};
+		std::size_t rx_size {0};
+		std::size_t tx_size {0};
+		char rx[kRxSize];
+		char tx[kTxSize];
+	};
+
+	struct MatchServer {
+		sf::IpAddress ip;
+		unsigned short port;
+	};
+
+	struct Stats {
+		sf::Uint64 joined;
+		sf::Uint64 pairs;
+		sf::Uint64 rejected;
+		sf::Uint64 timed_out;
+		sf::Int64 wait;
+		sf::Int64 gap;
+	};
+
+	// a client's end: what arrived and isn't a whole frame yet
+	struct Link {
+		sf::TcpSocket socket;
+		std::size_t rx_size {0};
+		char rx[kRxSize];
+	};
+
+	enum class Event {None, Ping, Ticket, Failed};
+
+	static Poller::Listener listener;
+	static std::vector<std::unique_ptr<Player>> players;
+	static std::unique_ptr<Player> spare;
+	static std::vector<Player*> flushing;
+	static Queue queue;
+	static std::vector<MatchServer> servers;
+	static std::size_t next_server;
+	static std::mt19937 generator;
+	static Stats stats;
+	static Poller::Set poller;
+
+	static bool ParseAddress(const char* address, unsigned short default_port,
+	                         sf::IpAddress* ip, unsigned short* port);
+	static void Poll(sf::Time timeout);
+	static void Accept();
+	static void Read(Player* player);
+	static bool Parse(Player* player);
+	static bool HandleHello(Player* player, const char* message, std::size_t size);
+	static void HandlePong(Player* player, const char* data, std::size_t size);
+	static void SendPing(Player* player);
+	static void Send(Player* player, const char* data, std::size_t size);
+	static void Match(sf::Int64 now);
+	static void Hand(Player* first, Player* second, sf::Int64 now);
+	static void Flush();
+	static void Expire(sf::Int64 now);
+	static void Close(Player* player);
+	static void Sweep();
+	static void PrintStats(sf::Time elapsed);
+	static std::size_t WriteHello(char* dest);
+	static bool Receive(Link* link);
+	static Event NextFrame(Link* link, char* ping, Ticket* ticket);
+	static bool SendPong(Link* link, const char* ping);
+}
+
+
+bool Lobby::Run(const char* const* const addresses, const int count)
+{
+	for (int i = 0; i < count; ++i) {
+		MatchServer server;
+		if (!ParseAddress(addresses[i], Connection::kPort, &server.ip, &server.port)) {
+			std::cerr << "unknown match server: " << addresses[i] << '\n';
+			return false;
+		}
+		servers.push_back(server);
+	}
+
+	if (listener.listen(kPort) != sf::Socket::Done) {
+		std::cerr << "failed to listen port " << kPort << '\n';
+		return false;
+	}
+
+	listener.setBlocking(false);
+	if (!Poller::Init(&poller) || !Poller::Watch(&listener, &listener, &poller)) {
+		std::cerr << "failed to initialize the socket poller\n";
+		return false;
+	}
+
+	generator.seed(std::random_device()());
+	std::cout << "lobby listening on port " << kPort << ", handing out "
+	          << servers.size() << " match servers\n";
+
+	const auto match_interval = sf::seconds(kMatchInterval).asMicroseconds();
+	const auto stats_interval = sf::seconds(kStatsInterval).asMicroseconds();
+	auto next_match = Connection::Now() + match_interval;
+	auto next_expire = next_match;
+	auto last_stats = Connection::Now();
+	for (;;) {
+		Poll(sf::microseconds(std::max<sf::Int64>(next_match - Connection::Now(), 0)));
+
+		const auto now = Connection::Now();
+		if (now >= next_match) {
+			Match(now);
+			next_match = now + match_interval;
+		}
+		Flush();
+
+		// closed players are only let go here, none is in the flushing list
+		if (now >= next_expire) {
+			Expire(now);
+			Flush();
+			Sweep();
+			next_expire = now + sf::seconds(1).asMicroseconds();
+		}
+
+		if (now - last_stats >= stats_interval) {
+			PrintStats(sf::microseconds(now - last_stats));
+			last_stats = now;
+		}
+	}
+}
+
+bool Lobby::ParseAddress(const char* const address, const unsigned short default_port,
+                         sf::IpAddress* const ip, unsigned short* const port)
+{
+	std::string host {address};
+	*port = default_port;
+	const auto colon = host.find(':');
+	if (colon != std::string::npos) {
+		*port = static_cast<unsigned short>(std::atoi(host.c_str() + colon + 1));
+		host.resize(colon);
+	}
+	*ip = host;
+	return *ip != sf::IpAddress::None;
+}
+
+void Lobby::Poll(const sf::Time timeout)
+{
+	void* ready[Poller::kMaxReady];
+	const auto count = Poller::Wait(timeout, &poller, ready);
+	for (int i = 0; i < count; ++i) {
+		if (ready[i] == &listener) {
+			Accept();
+		} else {
+			auto* const player = static_cast<Player*>(ready[i]);
+			if (player->state != State::Closed)
+				Read(player);
+		}
+	}
+}
+
+void Lobby::Accept()
+{
+	for (;;) {
+		if (!spare)
+			spare.reset(new Player);
+		if (listener.accept(spare->socket) != sf::Socket::Done)
+			return;
+
+		auto* const player = spare.get();
+		player->socket.setBlocking(false);
+		player->since = Connection::Now();
+		// a player the poller can't wake for is dropped, spare stays for the next
+		if (!Poller::Watch(&player->socket, player, &poller)) {
+			std::cerr << "failed to watch a player socket\n";
+			player->socket.disconnect();
+			continue;
+		}
+		players.push_back(std::move(spare));
+	}
+}
+
+void Lobby::Read(Player* const player)
+{
+	for (;;) {
+		std::size_t received;
+		const auto status = player->socket.receive(player->rx + player->rx_size,
+		                                           kRxSize - player->rx_size, received);
+		if (status == sf::Socket::NotReady)
+			return;
+
+		player->rx_size += received;
+		if (status != sf::Socket::Done || !Parse(player)) {
+			Close(player);
+			return;
+		}
+	}
+}
+
+bool Lobby::Parse(Player* const player)
+{
+	const auto* const bytes = reinterpret_cast<const unsigned char*>(player->rx);
+	std::size_t offset = 0;
+	while (player->rx_size - offset >= Connection::kFrameHeaderSize) {
+		const std::size_t header = (std::size_t(bytes[offset]) << 8) | bytes[offset + 1];
+		const auto size = header & ~std::size_t(Connection::kControlFrame);
+		const auto* const message = player->rx + offset + Connection::kFrameHeaderSize;
+		if (size > kMaxMessageSize)
+			return false;
+		if (player->rx_size - offset < Connection::kFrameHeaderSize + size)
+			break;
+		if (header & Connection::kControlFrame)
+			HandlePong(player, message, size);
+		else if (!HandleHello(player, message, size))
+			return false;
+		offset += Connection::kFrameHeaderSize + size;
+	}
+
+	player->rx_size -= offset;
+	std::memmove(player->rx, player->rx + offset, player->rx_size);
+	return true;
+}
+
+// a client built with other messages couldn't play the match it'd get
+bool Lobby::HandleHello(Player* const player, const char* const message, const std::size_t size)
+{
+	if (player->state != State::Hello || size != kHelloSize || message[0] != kHello ||
+	    Wire::ReadU32(message + 1) != Protocol::Tag(tick_rate())) {
+		++stats.rejected;
+		return false;
+	}
+
+	++stats.joined;
+	player->state = State::Measuring;
+	SendPing(player);
+	return true;
+}
+
+// the pong carries back the time the ping left, so nothing is kept per ping
+void Lobby::HandlePong(Player* const player, const char* const data, const std::size_t size)
+{
+	if (player->state != State::Measuring || size != Connection::kPongSize || data[0] != Connection::kPong)
+		return;
+
+	const auto sent = Wire::ReadU32(data + 1);
+	const sf::Int64 rtt = static_cast<sf::Uint32>(static_cast<sf::Uint32>(Connection::Now()) - sent);
+	player->rtt = player->pongs == 0 ? rtt : std::min(player->rtt, rtt);
+	if (++player->pongs < kPings) {
+		SendPing(player);
+		return;
+	}
+
+	player->state = State::Queued;
+	player->since = Connection::Now();
+	player->slot = queue.emplace(player->rtt, player);
+}
+
+void Lobby::SendPing(Player* const player)
+{
+	char frame[Connection::kFrameHeaderSize + Connection::kPingSize];
+	frame[0] = static_cast<char>((Connection::kControlFrame | Connection::kPingSize) >> 8);
+	frame[1] = static_cast<char>(Connection::kPingSize);
+	frame[2] = static_cast<char>(Connection::kPing);
+	Wire::WriteU32(static_cast<sf::Uint32>(Connection::Now()), frame + 3);
+	Send(player, frame, sizeof(frame));
+}
+
+// a player only ever has a ping or its ticket waiting, they always fit
+void Lobby::Send(Player* const player, const char* const data, const std::size_t size)
+{
+	if (player->tx_size + size > kTxSize) {
+		Close(player);
+		return;
+	}
+
+	std::memcpy(player->tx + player->tx_size, data, size);
+	player->tx_size += size;
+	if (!player->flushing) {
+		player->flushing = true;
+		flushing.push_back(player);
+	}
+}
+
+// the queue is walked in round trip order, each player paired with the
+// next one when their gap is within what the longer waiting of the two
+// allows. anyone is paired eventually, with whoever is closest
+void Lobby::Match(const sf::Int64 now)
+{
+	auto it = queue.begin();
+	while (it != queue.end()) {
+		const auto next = std::next(it);
+		if (next == queue.end())
+			break;
+
+		const auto waited = now - std::min(it->second->since, next->second->since);
+		const auto allowed = sf::seconds(kMaxGap).asMicroseconds() +
+		                     static_cast<sf::Int64>(waited * kGapGrowth);
+		if (next->first - it->first > allowed) {
+			it = next;
+			continue;
+		}
+
+		Hand(it->second, next->second, now);
+		it = queue.erase(it);
+		it = queue.erase(it);
+	}
+}
+
+// both get the same ticket and server, and hang up once they have it
+void Lobby::Hand(Player* const first, Player* const second, const sf::Int64 now)
+{
+	const auto& server = servers[next_server];
+	next_server = (next_server + 1) % servers.size();
+
+	Ticket ticket;
+	ticket.id = std::max<sf::Uint32>(generator(), 1);
+	ticket.address = server.ip.toInteger();
+	ticket.port = server.port;
+
+	char frame[Connection::kFrameHeaderSize + kTicketSize];
+	frame[0] = static_cast<char>(kTicketSize >> 8);
+	frame[1] = static_cast<char>(kTicketSize);
+	frame[2] = static_cast<char>(kTicket);
+	TicketSchema::Encode(ticket, frame + 3);
+
+	++stats.pairs;
+	stats.gap += second->rtt - first->rtt;
+	for (auto* const player : {first, second}) {
+		stats.wait += now - player->since;
+		player->state = State::Leaving;
+		player->since = now;
+		Send(player, frame, sizeof(frame));
+	}
+}
+
+void Lobby::Flush()
+{
+	std::size_t kept = 0;
+	for (auto* const player : flushing) {
+		if (player->state == State::Closed)
+			continue;
+
+		std::size_t sent = 0;
+		const auto status = player->socket.send(player->tx, player->tx_size, sent);
+		if (status == sf::Socket::Disconnected || status == sf::Socket::Error) {
+			Close(player);
+			continue;
+		}
+
+		player->tx_size -= sent;
+		std::memmove(player->tx, player->tx + sent, player->tx_size);
+		player->flushing = player->tx_size > 0;
+		if (player->flushing)
+			flushing[kept++] = player;
+	}
+	flushing.resize(kept);
+}
+
+void Lobby::Expire(const sf::Int64 now)
+{
+	const auto hello_timeout = sf::seconds(kHelloTimeout).asMicroseconds();
+	const auto leave_timeout = sf::seconds(kLeaveTimeout).asMicroseconds();
+	for (auto& player : players) {
+		const auto waited = now - player->since;
+		if (((player->state == State::Hello || player->state == State::Measuring) && waited > hello_timeout) ||
+		    (player->state == State::Leaving && waited > leave_timeout)) {
+			++stats.timed_out;
+			Close(player.get());
+		}
+	}
+}
+
+void Lobby::Close(Player* const player)
+{
+	if (player->state == State::Closed)
+		return;
+
+	if (player->state == State::Queued)
+		queue.erase(player->slot);
+	player->state = State::Closed;
+	Poller::Unwatch(&player->socket, &poller);
+	player->socket.disconnect();
+}
+
+void Lobby::Sweep()
+{
+	players.erase(std::remove_if(players.begin(), players.end(),
+	                             [](const std::unique_ptr<Player>& player) { return player->state == State::Closed; }),
+	              players.end());
+}
+
+void Lobby::PrintStats(const sf::Time elapsed)
+{
+	const auto pairs = stats.pairs > 0 ? stats.pairs : 1;
+	std::cout << "players: " << players.size()
+	          << ", queued: " << queue.size()
+	          << ", joined: " << stats.joined / elapsed.asSeconds() << "/s"
+	          << ", paired: " << stats.pairs
+	          << " (waited " << stats.wait / 1000.f / (2 * pairs) << " ms"
+	          << ", round trips " << stats.gap / 1000.f / pairs << " ms apart)"
+	          << ", rejected: " << stats.rejected
+	          << ", timed out: " << stats.timed_out << '\n';
+	stats = Stats();
+}
+
+bool Lobby::Join(const char* const address, const sf::Time limit,
+                 const std::atomic<bool>& running, Ticket* const ticket)
+{
+	sf::IpAddress ip;
+	unsigned short port;
+	Link link;
+	if (!ParseAddress(address, kPort, &ip, &port)) {
+		std::cerr << "unknown lobby: " << address << '\n';
+		return false;
+	}
+
+	const sf::Clock clock;
+	char hello[Connection::kFrameHeaderSize + kHelloSize];
+	if (link.socket.connect(ip, port, limit) != sf::Socket::Done ||
+	    link.socket.send(hello, WriteHello(hello)) != sf::Socket::Done) {
+		std::cerr << "failed to join the lobby\n";
+		return false;
+	}
+
+	std::cout << "waiting in the lobby for an opponent...\n";
+	link.socket.setBlocking(false);
+	sf::SocketSelector selector;
+	selector.add(link.socket);
+	while (running && clock.getElapsedTime() < limit) {
+		if (!selector.wait(sf::milliseconds(100)))
+			continue;
+		if (!Receive(&link))
+			break;
+
+		char ping[Connection::kPingSize];
+		for (auto event = NextFrame(&link, ping, ticket); event != Event::None;
+		     event = NextFrame(&link, ping, ticket)) {
+			if (event == Event::Ticket)
+				return true;
+			else if (event == Event::Failed || !SendPong(&link, ping))
+				return false;
+		}
+	}
+
+	if (running)
+		std::cerr << "the lobby found no opponent\n";
+	return false;
+}
+
+std::size_t Lobby::WriteHello(char* const dest)
+{
+	dest[0] = static_cast<char>(kHelloSize >> 8);
+	dest[1] = static_cast<char>(kHelloSize);
+	dest[2] = static_cast<char>(kHello);
+	Wire::WriteU32(Protocol::Tag(tick_rate()), dest + 3);
+	return Connection::kFrameHeaderSize + kHelloSize;
+}
+
+bool Lobby::Receive(Link* const link)
+{
+	std::size_t received = 0;
+	const auto status = link->socket.receive(link->rx + link->rx_size, kRxSize - link->rx_size, received);
+	link->rx_size += received;
+	return status == sf::Socket::Done || status == sf::Socket::NotReady;
+}
+
+Lobby::Event Lobby::NextFrame(Link* const link, char* const ping, Ticket* const ticket)
+{
+	const auto* const bytes = reinterpret_cast<const unsigned char*>(link->rx);
+	if (link->rx_size < Connection::kFrameHeaderSize)
+		return Event::None;
+
+	const std::size_t header = (std::size_t(bytes[0]) << 8) | bytes[1];
+	const auto size = header & ~std::size_t(Connection::kControlFrame);
+	const auto* const message = link->rx + Connection::kFrameHeaderSize;
+	if (size > kMaxMessageSize)
+		return Event::Failed;
+	if (link->rx_size < Connection::kFrameHeaderSize + size)
+		return Event::None;
+
+	auto event = Event::Failed;
+	if ((header & Connection::kControlFrame) && size == Connection::kPingSize && message[0] == Connection::kPing) {
+		std::memcpy(ping, message, size);
+		event = Event::Ping;
+	} else if (!(header & Connection::kControlFrame) && size == kTicketSize && message[0] == kTicket &&
+	           TicketSchema::Decode(message + 1, size - 1, ticket)) {
+		event = Event::Ticket;
+	}
+
+	link->rx_size -= Connection::kFrameHeaderSize + size;
+	std::memmove(link->rx, link->rx + Connection::kFrameHeaderSize + size, link->rx_size);
+	return event;
+}
+
+bool Lobby::SendPong(Link* const link, const char* const ping)
+{
+	char frame[Connection::kFrameHeaderSize + Connection::kPongSize];
+	frame[0] = static_cast<char>((Connection::kControlFrame | Connection::kPongSize) >> 8);
+	frame[1] = static_cast<char>(Connection::kPongSize);
+	Connection::WritePong(ping, frame + Connection::kFrameHeaderSize);
+	return link->socket.send(frame, sizeof(frame)) == sf::Socket::Done;
+}
+
+// every client is connected before any says hello, so they all queue up
+// together, then their sockets are polled in turn. a pong is held back
+// until its client's delay passed, which is what the lobby measures
+bool Lobby::Simulate(const char* const address, const int count)
+{
+	struct Synthetic {
+		Link link;
+		sf::Int64 delay;
+		sf::Int64 joined;
+		// when the ping held goes back, 0 with none
+		sf::Int64 pong_due {0};
+		char ping[Connection::kPingSize];
+		Ticket ticket;
+		sf::Int64 waited {-1};
+		bool failed {false};
+	};
+
+	sf::IpAddress ip;
+	unsigned short port;
+	if (!ParseAddress(address, kPort, &ip, &port)) {
+		std::cerr << "unknown lobby: " << address << '\n';
+		return false;
+	}
+
+	std::vector<std::unique_ptr<Synthetic>> clients;
+	for (int i = 0; i < count; ++i) {
+		std::unique_ptr<Synthetic> client(new Synthetic);
+		if (client->link.socket.connect(ip, port, sf::seconds(kHelloTimeout)) != sf::Socket::Done) {
+			std::cerr << "synthetic client " << i << " failed to connect, the open files limit may be too low\n";
+			return false;
+		}
+		client->delay = (i % kLatencyClasses) * sf::seconds(kLatencyStep).asMicroseconds();
+		clients.push_back(std::move(client));
+	}
+
+	std::cout << count << " synthetic clients connected, joining\n";
+	const auto start = Connection::Now();
+	int failed = 0;
+	for (auto& client : clients) {
+		char hello[Connection::kFrameHeaderSize + kHelloSize];
+		client->failed = client->link.socket.send(hello, WriteHello(hello)) != sf::Socket::Done;
+		client->link.socket.setBlocking(false);
+		client->joined = Connection::Now();
+		failed += client->failed;
+	}
+
+	// an odd one out has no one to pair with
+	const auto expected = count - count % 2;
+	const auto deadline = start + sf::seconds(kSimulateTimeout).asMicroseconds();
+	int paired = 0;
+	while (paired + failed < expected && Connection::Now() < deadline) {
+		bool idle = true;
+		for (auto& client : clients) {
+			if (client->failed || client->waited >= 0)
+				continue;
+
+			const auto now = Connection::Now();
+			if (client->pong_due != 0 && now >= client->pong_due) {
+				client->pong_due = 0;
+				client->failed = !SendPong(&client->link, client->ping);
+			}
+
+			const auto size = client->link.rx_size;
+			client->failed = client->failed || !Receive(&client->link);
+			idle = idle && client->link.rx_size == size;
+			for (auto event = NextFrame(&client->link, client->ping, &client->ticket);
+			     !client->failed && event != Event::None;
+			     event = NextFrame(&client->link, client->ping, &client->ticket)) {
+				if (event == Event::Ping) {
+					client->pong_due = now + client->delay;
+				} else if (event == Event::Ticket) {
+					client->waited = now - client->joined;
+					client->link.socket.disconnect();
+					++paired;
+					break;
+				} else {
+					client->failed = true;
+				}
+			}
+
+			if (client->failed) {
+				client->link.socket.disconnect();
+				++failed;
+			}
+		}
+		if (idle)
+			sf::sleep(sf::milliseconds(1));
+	}
+
+	const auto elapsed = Connection::Now() - start;
+	bool ok = failed == 0 && paired == expected;
+	if (!ok)
+		std::cerr << paired << " of " << expected << " synthetic clients paired, " << failed << " failed\n";
+
+	// a ticket goes to exactly two clients, both sent to the same server
+	std::map<sf::Uint32, std::vector<int>> tickets;
+	std::vector<sf::Int64> waits;
+	for (int i = 0; i < count; ++i) {
+		if (clients[i]->waited >= 0) {
+			tickets[clients[i]->ticket.id].push_back(i);
+			waits.push_back(clients[i]->waited);
+		}
+	}
+
+	int same_latency = 0;
+	for (const auto& ticket : tickets) {
+		const auto& holders = ticket.second;
+		if (holders.size() != 2 ||
+		    clients[holders[0]]->ticket.address != clients[holders[1]]->ticket.address ||
+		    clients[holders[0]]->ticket.port != clients[holders[1]]->ticket.port) {
+			std::cerr << "ticket " << ticket.first << " went to " << holders.size() << " clients\n";
+			ok = false;
+		} else if (holders[0] % kLatencyClasses == holders[1] % kLatencyClasses) {
+			++same_latency;
+		}
+	}
+
+	std::sort(waits.begin(), waits.end());
+	const auto percentile = [&waits](const std::size_t percent) {
+		return waits.empty() ? 0.f : waits[(waits.size() - 1) * percent / 100] / 1000.f;
+	};
+	std::cout << "synthetic: " << paired << " clients paired in " << elapsed / 1000.f << " ms"
+	          << ", waited p50 " << percentile(50) << " ms, p90 " << percentile(90)
+	          << " ms, p99 " << percentile(99) << " ms, max " << percentile(100) << " ms"
+	          << ", " << 100.f * same_latency / std::max<std::size_t>(tickets.size(), 1)
+	          << "% of the pairs of the same latency\n";
+	return ok;
+}
@@ -0,0 +1,56 @@
+#ifndef PONGON_LOBBY_HPP_
+#define PONGON_LOBBY_HPP_
+#include <cstddef>
+#include <atomic>
+
+#include <SFML/System.hpp>
+
+#include "schema.hpp"
+
+// matchmaking in front of -dedicated servers. a client joining with
+// -lobby has its round trip measured with a few pings and is queued, the
+// queue kept in round trip order, and the closest two are paired. the gap
+// allowed between them starts at kMaxGap and widens the longer the one
+// that came first waits. each pair is handed the next match server in
+// turn and a ticket, which the client presents to it as its session token
+// so the server pairs them. frames are like the game's: a 2 byte size,
+// kControlFrame set on the pings and pongs, which are Connection's. a
+// message starts with its kind. hello: the protocol tag, 32 bits. ticket:
+// see TicketSchema
+namespace Lobby {
+	constexpr const unsigned short kPort {7174};
+	enum Kind : sf::Uint8 {kHello, kTicket};
+	constexpr const std::size_t kMaxMessageSize {32};
+	// pinged back to back, the shortest round trip is the one kept
+	constexpr const int kPings {4};
+	// seconds of round trip difference allowed, and how much that grows
+	// each second in the queue
+	constexpr const float kMaxGap {0.02f};
+	constexpr const float kGapGrowth {0.05f};
+	constexpr const float kMatchInterval {0.25f};
+	constexpr const float kStatsInterval {10.f};
+
+	struct Ticket {
+		sf::Uint32 id;
+		sf::Uint32 address;
+		sf::Uint16 port;
+	};
+
+	using TicketSchema = Schema::Struct<
+		PONGON_FIELD(Ticket::id, Schema::Unsigned<32>),
+		PONGON_FIELD(Ticket::address, Schema::Unsigned<32>),
+		PONGON_FIELD(Ticket::port, Schema::Unsigned<16>)>;
+
+	// servers: the match servers handed out, each "host[:port]"
+	bool Run(const char* const* servers, int count);
+	// run by a client's network thread, until a ticket comes, limit passes
+	// or running is cleared
+	bool Join(const char* address, sf::Time limit, const std::atomic<bool>& running, Ticket* ticket);
+	// joins with count synthetic clients, each answering the pings late by
+	// one of kLatencyClasses delays, and checks how they got paired
+	constexpr const int kLatencyClasses {8};
+	constexpr const float kLatencyStep {0.05f};
+	bool Simulate(const char* address, int count);
+}
+
+#endif
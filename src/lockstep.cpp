@@ -0,0 +1,348 @@
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include "connection.hpp"
+#include "interpolation.hpp"
+#include "lockstep.hpp"
+#include "replay.hpp"
+#include "wire.hpp"
+
+namespace Lockstep {
+	Stats stats;
+
+	// what the client needs to simulate a past frame again
+	struct Record {
+		GameState state;
+		float local;
+		float remote;
+	};
+
+	constexpr const sf::Int32 kHistorySize {64};
+	constexpr const Scalar kEase {to_scalar(0.15f)};
+	constexpr const float kSnapDistance {kPaddleHeight};
+	static Record history[kHistorySize];
+	static sf::Int32 frame;
+	static Vector correction;
+	static bool interpolate;
+	// the frame's message went out and the peer's one is awaited
+	static bool sent;
+	static float sent_velocity;
+	// the peer's input, kept when a frame of it is missing
+	static float remote_velocity;
+	static Peer peer;
+
+	// input and flags, the ack, a full snapshot and a paddle sample
+	constexpr const int kMaxSnapshotBits {Wire::kFrameBits + 8 + 2 * (Wire::kMaxSmallBits) + 1 + 2 * Wire::kValueBits};
+	static_assert((HeadSchema::kBits + 1 + Wire::kFrameBits + kMaxSnapshotBits +
+	               PaddleSchema::kBits + 7) / 8 <= kMaxPayloadSize,
+	              "the largest message must fit in kMaxPayloadSize");
+
+	static void Reconcile(const Snapshot& snapshot, GameState* state);
+	static QuantizedSnapshot Quantize(const Snapshot& snapshot);
+	static Snapshot Dequantize(const QuantizedSnapshot& snapshot);
+	static const QuantizedSnapshot* FindBaseline(const QuantizedSnapshot* snapshots, sf::Int32 frame);
+	static sf::Int32 Predict(const QuantizedSnapshot& base, int axis, sf::Int32 frames);
+}
+
+
+void Lockstep::Init(const bool interpolate_remote)
+{
+	interpolate = interpolate_remote;
+	if (interpolate)
+		Interpolation::Init();
+	peer.paddle_time = 0;
+	Restart();
+	stats = Stats();
+}
+
+// the peer's paddle times go on from where they were
+void Lockstep::Restart()
+{
+	const auto paddle_time = peer.paddle_time;
+	frame = 0;
+	correction = {to_scalar(0.f), to_scalar(0.f)};
+	sent = false;
+	remote_velocity = 0.f;
+	InitPeer(Connection::transport != Connection::Transport::Udp, &peer);
+	peer.paddle_time = paddle_time;
+}
+
+// the frame's message is sent once, then the update keeps returning
+// without advancing until the peer's frame arrives, so a network stall
+// doesn't keep the window from being drawn. over udp a missing frame is
+// not waited for, the remote paddle keeps its velocity
+bool Lockstep::Update(const float local_input, GameState* const state)
+{
+	char received_payload[kMaxPayloadSize];
+	const auto slot = frame % kHistorySize;
+
+	if (!sent) {
+		Message message {};
+		if (!Connection::is_server) {
+			history[slot].state = *state;
+		} else if (frame % kSnapshotInterval == 0) {
+			message.snapshot = {frame, state->ball, state->ball_velocity};
+			message.flags |= kHasSnapshot;
+		}
+
+		if (interpolate) {
+			message.paddle = {Interpolation::Now(), to_float(state->local.y)};
+			message.flags |= kHasPaddle;
+		}
+
+		// the peer is sent what the frame will run with, a key changing the
+		// input while waiting for its frame goes to the next one
+		message.velocity = clamp_velocity(state->local, local_input);
+
+		char payload[kMaxPayloadSize];
+		if (!Connection::SendMessage(payload, Encode(message, &peer, payload)))
+			return false;
+		sent = true;
+		sent_velocity = message.velocity;
+	}
+
+	// without the peer's frame the update simulates nothing and the next
+	// one tries again, the window keeps being drawn meanwhile
+	std::size_t received;
+	if (!Connection::ReceiveMessage(received_payload, sizeof(received_payload), &received))
+		return false;
+	if (received == 0 && Connection::transport == Connection::Transport::Tcp)
+		return true;
+
+	sent = false;
+
+	// a bad payload counts as not received
+	Message message {};
+	if (received > 0 && Decode(received_payload, received, frame, &peer, &message))
+		remote_velocity = message.velocity;
+	else
+		message.flags = 0;
+	const auto received_flags = message.flags;
+	const auto& snapshot = message.snapshot;
+	const auto& sample = message.paddle;
+
+	const Inputs inputs {sent_velocity, remote_velocity};
+	history[slot].local = inputs.local;
+	history[slot].remote = inputs.remote;
+	step(inputs, state);
+	Replay::Record(inputs.local, inputs.remote, &Replay::recorder);
+	++frame;
+	++stats.frames;
+
+	if (interpolate) {
+		float remote_y;
+		if (received_flags & kHasPaddle)
+			Interpolation::Push(sample.time, sample.y);
+		if (Interpolation::Sample(&remote_y))
+			state->remote.y = to_scalar(remote_y);
+	}
+
+	if (!Connection::is_server) {
+		if (received_flags & kHasSnapshot)
+			Reconcile(snapshot, state);
+
+		const Vector ease {correction.x * kEase, correction.y * kEase};
+		state->ball.x += ease.x;
+		state->ball.y += ease.y;
+		correction.x -= ease.x;
+		correction.y -= ease.y;
+	}
+	return true;
+}
+
+void Lockstep::PrintStats()
+{
+	std::cout << "lockstep: " << stats.frames << " frames, "
+	          << stats.snapshots << " ball snapshots, "
+	          << stats.snaps << " snapped, "
+	          << stats.max_error << " px max error\n";
+	if (interpolate)
+		Interpolation::PrintStats();
+}
+
+// the snapshot is taken back to our present by simulating again the
+// frames since then with the ball replaced. the velocity is taken right
+// away, but the position difference is eased in over the next frames
+void Lockstep::Reconcile(const Snapshot& snapshot, GameState* const state)
+{
+	if (snapshot.frame < frame - kHistorySize)
+		return;
+
+	++stats.snapshots;
+	auto replayed = *state;
+	if (snapshot.frame < frame) {
+		replayed = history[snapshot.frame % kHistorySize].state;
+		replayed.ball = snapshot.position;
+		replayed.ball_velocity = snapshot.velocity;
+		for (auto f = snapshot.frame; f < frame; ++f) {
+			// the paddles go where they really were, interpolated or not
+			const auto& record = history[f % kHistorySize];
+			replayed.local.y = record.state.local.y;
+			replayed.remote.y = record.state.remote.y;
+			step({record.local, record.remote}, &replayed);
+		}
+	} else {
+		// the server is ahead, take it as our present
+		replayed.ball = snapshot.position;
+		replayed.ball_velocity = snapshot.velocity;
+	}
+
+	state->ball_velocity = replayed.ball_velocity;
+	correction = {replayed.ball.x - state->ball.x, replayed.ball.y - state->ball.y};
+	const auto error = std::hypot(to_float(correction.x), to_float(correction.y));
+	stats.max_error = std::max(stats.max_error, error);
+	if (error > kSnapDistance) {
+		state->ball = replayed.ball;
+		correction = {to_scalar(0.f), to_scalar(0.f)};
+		++stats.snaps;
+	}
+}
+
+void Lockstep::InitPeer(const bool reliable, Peer* const peer)
+{
+	for (auto& snapshot : peer->sent)
+		snapshot.frame = -1;
+	for (auto& snapshot : peer->received)
+		snapshot.frame = -1;
+	peer->last_sent = -1;
+	peer->acked = -1;
+	peer->last_received = -1;
+	peer->paddle_time = 0;
+	peer->reliable = reliable;
+}
+
+// input 2 bits, flags 2 bits and over udp an ack bit, followed by the
+// newest snapshot frame received when set. then if flagged:
+// snapshot: frame 16 bits and the distance in frames to the baseline, 8
+// bits. with no baseline the position and velocity at 16 bits each,
+// else the position as a small delta from where the baseline's velocity
+// takes it and a bit telling the velocity changed, followed by it if so
+// paddle: time 16 bits and y 16 bits
+std::size_t Lockstep::Encode(const Message& message, Peer* const peer, char* const dest)
+{
+	Wire::Writer writer {dest, kMaxPayloadSize, 0};
+	HeadSchema::Write(&writer, message);
+	if (!peer->reliable) {
+		Wire::Write(&writer, peer->last_received >= 0, 1);
+		if (peer->last_received >= 0)
+			Wire::Write(&writer, static_cast<sf::Uint32>(peer->last_received), Wire::kFrameBits);
+	}
+
+	if (message.flags & kHasSnapshot) {
+		const auto snapshot = Quantize(message.snapshot);
+		const auto base_frame = peer->reliable ? peer->last_sent : peer->acked;
+		const auto* const base = FindBaseline(peer->sent, base_frame);
+		const auto distance = snapshot.frame - base_frame;
+		Wire::Write(&writer, static_cast<sf::Uint32>(snapshot.frame), Wire::kFrameBits);
+		if (base != nullptr && distance > 0 && distance < 256) {
+			Wire::Write(&writer, static_cast<sf::Uint32>(distance), 8);
+			for (int axis = 0; axis < 2; ++axis)
+				Wire::WriteSmall(&writer, snapshot.position[axis] - Predict(*base, axis, distance));
+			const bool changed = snapshot.velocity[0] != base->velocity[0] ||
+			                     snapshot.velocity[1] != base->velocity[1];
+			Wire::Write(&writer, changed, 1);
+			for (int axis = 0; changed && axis < 2; ++axis)
+				Wire::WriteSigned(&writer, snapshot.velocity[axis], Wire::kValueBits);
+		} else {
+			Wire::Write(&writer, 0, 8);
+			SnapshotSchema::Write(&writer, snapshot);
+		}
+
+		peer->sent[(snapshot.frame / kSnapshotInterval) % kBaselineCount] = snapshot;
+		peer->last_sent = snapshot.frame;
+	}
+
+	if (message.flags & kHasPaddle)
+		PaddleSchema::Write(&writer, message.paddle);
+
+	return Wire::Size(writer);
+}
+
+// a snapshot against a baseline we don't have is read through and left out
+bool Lockstep::Decode(const char* const src, const std::size_t size, const sf::Int32 frame,
+                      Peer* const peer, Message* const message)
+{
+	Wire::Reader reader {src, size, 0, false};
+	HeadSchema::Read(&reader, message);
+	if (!peer->reliable && Wire::Read(&reader, 1)) {
+		const auto ack = Wire::Expand(Wire::Read(&reader, Wire::kFrameBits), peer->last_sent);
+		if (ack <= peer->last_sent)
+			peer->acked = std::max(peer->acked, ack);
+	}
+
+	if (message->flags & kHasSnapshot) {
+		QuantizedSnapshot snapshot;
+		snapshot.frame = Wire::Expand(Wire::Read(&reader, Wire::kFrameBits), frame);
+		const auto distance = static_cast<sf::Int32>(Wire::Read(&reader, 8));
+		const QuantizedSnapshot* base = nullptr;
+		if (distance == 0) {
+			SnapshotSchema::Read(&reader, &snapshot);
+		} else {
+			base = FindBaseline(peer->received, snapshot.frame - distance);
+			sf::Int32 deltas[2];
+			for (int axis = 0; axis < 2; ++axis)
+				deltas[axis] = Wire::ReadSmall(&reader);
+			const bool changed = Wire::Read(&reader, 1) != 0;
+			for (int axis = 0; changed && axis < 2; ++axis)
+				snapshot.velocity[axis] = Wire::ReadSigned(&reader, Wire::kValueBits);
+
+			for (int axis = 0; base != nullptr && axis < 2; ++axis) {
+				snapshot.position[axis] = Predict(*base, axis, distance) + deltas[axis];
+				if (!changed)
+					snapshot.velocity[axis] = base->velocity[axis];
+			}
+		}
+
+		if ((distance == 0 || base != nullptr) && !reader.overflow) {
+			peer->received[(snapshot.frame / kSnapshotInterval) % kBaselineCount] = snapshot;
+			peer->last_received = std::max(peer->last_received, snapshot.frame);
+			message->snapshot = Dequantize(snapshot);
+		} else {
+			message->flags &= ~kHasSnapshot;
+		}
+	}
+
+	if (message->flags & kHasPaddle) {
+		PaddleSchema::Read(&reader, &message->paddle);
+		message->paddle.time = Wire::Expand(static_cast<sf::Uint32>(message->paddle.time), peer->paddle_time);
+		if (!reader.overflow)
+			peer->paddle_time = message->paddle.time;
+	}
+
+	return !reader.overflow && (reader.bits + 7) / 8 == size;
+}
+
+Lockstep::QuantizedSnapshot Lockstep::Quantize(const Snapshot& snapshot)
+{
+	return {snapshot.frame,
+	        {Wire::Quantize(to_float(snapshot.position.x), Wire::kPositionScale),
+	         Wire::Quantize(to_float(snapshot.position.y), Wire::kPositionScale)},
+	        {Wire::Quantize(to_float(snapshot.velocity.x), Wire::kVelocityScale),
+	         Wire::Quantize(to_float(snapshot.velocity.y), Wire::kVelocityScale)}};
+}
+
+Lockstep::Snapshot Lockstep::Dequantize(const QuantizedSnapshot& snapshot)
+{
+	return {snapshot.frame,
+	        {to_scalar(Wire::Dequantize(snapshot.position[0], Wire::kPositionScale)),
+	         to_scalar(Wire::Dequantize(snapshot.position[1], Wire::kPositionScale))},
+	        {to_scalar(Wire::Dequantize(snapshot.velocity[0], Wire::kVelocityScale)),
+	         to_scalar(Wire::Dequantize(snapshot.velocity[1], Wire::kVelocityScale))}};
+}
+
+const Lockstep::QuantizedSnapshot* Lockstep::FindBaseline(const QuantizedSnapshot* const snapshots, const sf::Int32 frame)
+{
+	if (frame < 0)
+		return nullptr;
+	const auto& snapshot = snapshots[(frame / kSnapshotInterval) % kBaselineCount];
+	return snapshot.frame == frame ? &snapshot : nullptr;
+}
+
+// where the baseline's velocity takes its position, in integers so both
+// sides get the very same
+sf::Int32 Lockstep::Predict(const QuantizedSnapshot& base, const int axis, const sf::Int32 frames)
+{
+	constexpr const auto kRatio = static_cast<sf::Int32>(Wire::kVelocityScale / Wire::kPositionScale);
+	return base.position[axis] + base.velocity[axis] * frames / kRatio;
+}
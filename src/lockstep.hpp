@@ -0,0 +1,100 @@
+#ifndef PONGON_LOCKSTEP_HPP_
+#define PONGON_LOCKSTEP_HPP_
+#include <SFML/System.hpp>
+
+#include "schema.hpp"
+#include "simulation.hpp"
+
+// both peers exchange their paddle velocity and simulate the frame. the
+// server owns the ball: every few frames it sends a snapshot of it and
+// the client, which keeps predicting the ball, eases into the server's.
+// optionally the remote paddle is placed from interpolated positions
+// instead of the velocity, smoothing out jitter and lost datagrams
+namespace Lockstep {
+	constexpr const sf::Int32 kSnapshotInterval {6};
+
+	// the ball at the start of a frame
+	struct Snapshot {
+		sf::Int32 frame;
+		Vector position;
+		Vector velocity;
+	};
+
+	// the sender's paddle at the start of a frame, for interpolation
+	struct PaddleSample {
+		sf::Int32 time;
+		float y;
+	};
+
+	enum Flags : sf::Uint8 {kHasSnapshot = 1, kHasPaddle = 2};
+
+	// what one frame's message carries, the flags tell which parts
+	struct Message {
+		float velocity;
+		sf::Uint8 flags;
+		Snapshot snapshot;
+		PaddleSample paddle;
+	};
+
+	// a snapshot as it goes on the wire, in fixed point
+	struct QuantizedSnapshot {
+		sf::Int32 frame;
+		sf::Int32 position[2];
+		sf::Int32 velocity[2];
+	};
+
+	// what every message starts with, a new field for every frame goes
+	// here. a paddle sample's time goes as its low bits, and a snapshot
+	// without a baseline as it is
+	using HeadSchema = Schema::Struct<
+		PONGON_FIELD(Message::velocity, Schema::Input),
+		PONGON_FIELD(Message::flags, Schema::Unsigned<2>)>;
+	using PaddleSchema = Schema::Struct<
+		PONGON_FIELD(PaddleSample::time, Schema::Unsigned<Wire::kFrameBits>),
+		PONGON_FIELD(PaddleSample::y, Schema::Fixed<Schema::PositionScale>)>;
+	using SnapshotSchema = Schema::Struct<
+		PONGON_FIELD(QuantizedSnapshot::position, Schema::Signed<Wire::kValueBits>),
+		PONGON_FIELD(QuantizedSnapshot::velocity, Schema::Signed<Wire::kValueBits>)>;
+
+	// snapshots are delta encoded against one the peer is known to have.
+	// over tcp that is just the previous one, over udp the receiver acks
+	// the newest it got in every message. each side keeps one Peer for
+	// the other
+	constexpr const sf::Int32 kBaselineCount {16};
+	struct Peer {
+		QuantizedSnapshot sent[kBaselineCount];
+		QuantizedSnapshot received[kBaselineCount];
+		sf::Int32 last_sent;
+		sf::Int32 acked;
+		sf::Int32 last_received;
+		// the last paddle sample time, the next ones go as its low bits
+		sf::Int32 paddle_time;
+		bool reliable;
+	};
+
+	// bit packed, see Encode. a full snapshot with the ack and a paddle
+	// sample is 18 bytes, a delta one is usually 8
+	constexpr const std::size_t kMaxPayloadSize {24};
+
+	struct Stats {
+		sf::Uint32 frames;
+		sf::Uint32 snapshots;
+		sf::Uint32 snaps;
+		float max_error;
+	};
+
+	extern Stats stats;
+
+	void Init(bool interpolate_remote);
+	// goes back to frame 0 from the current state, after a resync
+	void Restart();
+	bool Update(float local_input, GameState* state);
+	void PrintStats();
+	void InitPeer(bool reliable, Peer* peer);
+	// dest holds kMaxPayloadSize, returns the bytes written. Decode needs
+	// the receiver's frame to expand the snapshot's, false on a bad payload
+	std::size_t Encode(const Message& message, Peer* peer, char* dest);
+	bool Decode(const char* src, std::size_t size, sf::Int32 frame, Peer* peer, Message* message);
+}
+
+#endif
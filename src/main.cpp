@@ -1,5 +1,6 @@
 #include <cmath>
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 #include <cstdint>
 
@@ -12,95 +13,77 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Network.hpp>
 
-constexpr const unsigned int kWinWidth {512};
-constexpr const unsigned int kWinHeight {256};
-
-constexpr const float kBallRadius {10.5f};
-constexpr const float kBallVelocity {2.5f};
-
-struct Ball : sf::CircleShape {
-	Ball() : sf::CircleShape(kBallRadius) {
-		setPosition(kWinWidth / 2, kWinHeight / 2);
-		setOrigin(kBallRadius, kBallRadius);
-		setFillColor(sf::Color::Green);
-		setOutlineColor(sf::Color::Magenta);
-	}
-};
-
-constexpr const float kPaddleWidth {15.f};
-constexpr const float kPaddleHeight {60.f};
-constexpr const float kPaddleVelocity {8.8f};
-
-struct Paddle : sf::RectangleShape {
-	Paddle() : sf::RectangleShape({kPaddleWidth, kPaddleHeight}) {
-		setOrigin(kPaddleWidth / 2, kPaddleHeight / 2);
-		setFillColor(sf::Color::Red);
-		setOutlineColor(sf::Color::Green);
-	}
-};
-
-struct Shapes {
-	Ball ball;
-	Paddle local;
-	Paddle remote;
-};
-
-struct Velocities {
-	sf::Vector2f ball {kBallVelocity, kBallVelocity / 4};
-	float local {0.f};
-	float remote {0.f};
-};
-
-struct Position {
-	float top, bottom, left, right;
-};
-
-struct Positions {
-	Position ball;
-	Position local;
-	Position remote;
-};
-
-namespace Connection {
-	enum class Mode {Server, Client};
-	constexpr const unsigned short kPort {7171};
-	static sf::TcpSocket socket;
-	static std::string local_nick;
-	static std::string remote_nick;
-	static std::string sending_msg;
-	static std::string receiving_msg;
-	static std::thread stdin_updater;
-	static std::vector<std::string> chat_msgs;
-	static std::size_t bytes_received;
-	static sf::Socket::Status status;
-	static bool is_running;
-	static bool is_server;
-
-	static bool Init(Mode mode);
-	static void Close();
-	static void UpdateChat();
-	static void PrintChat();
-	static bool Exchange(sf::Packet* send, sf::Packet* receive);
-	template<class Data>
-	bool Exchange(Data sending, Data* receiving);
-	template<class SendFunc, class ReceiveFunc>
-	bool ExchangeFun(SendFunc send, ReceiveFunc receive);
-	template<class ...Args>
-	bool Send(Args&& ...args);
-	template<class ...Args>
-	bool Receive(Args&& ...args);
-}
-
-static void update_positions(const Shapes& shapes, Positions* positions);
-static void update_velocities(const Positions& positions, Velocities* velocities);
-static void update_shapes(const Velocities& velocities, Shapes* shapes);
-static void process_input(sf::Keyboard::Key code, bool pressed, Velocities* velocities);
-static void set_initial_positions(Paddle* local, Paddle* remote);
+#include "allocations.hpp"
+#include "batch.hpp"
+#include "benchmark.hpp"
+#include "connection.hpp"
+#include "desync.hpp"
+#include "game.hpp"
+#include "hud.hpp"
+#include "lobby.hpp"
+#include "lockstep.hpp"
+#include "rollback.hpp"
+#include "input_delay.hpp"
+#include "replay.hpp"
+#include "server.hpp"
+#include "spectator.hpp"
+#include "proxy.hpp"
+#include "timestep.hpp"
+
+enum class Netcode {Lockstep, Rollback, InputDelay};
+
+static sf::Uint32 simulated_frames(Netcode netcode);
+static bool resync(Netcode netcode, GameState* state, bool* done);
+static void process_input(sf::Keyboard::Key code, bool pressed, float* velocity);
 
 int main(int argc, char** argv)
 {
-	if (argc > 1) {
+	auto netcode = Netcode::Lockstep;
+	int netcode_frames {0};
+	int check_interval {0};
+	bool interpolate {false};
+	bool hud {false};
+	float stats_interval {0.f};
+	float tick_rate {Timestep::kDefaultRate};
+	// 0 draws as fast as it goes
+	int frame_limit {60};
+	bool vsync {false};
+	float timeout {Connection::kDefaultTimeout};
+	int retries {Connection::kDefaultRetries};
+	const char* record_path {nullptr};
+	const char* lobby_address {nullptr};
+	if (argc == 2 && std::strcmp(argv[1], "-dedicated") == 0) {
+		return Server::Run(nullptr) ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else if (argc == 4 && std::strcmp(argv[1], "-dedicated") == 0 && std::strcmp(argv[2], "-record") == 0) {
+		return Server::Run(argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else if ((argc == 3 || argc == 4) && std::strcmp(argv[1], "-replay") == 0) {
+		if (argc == 4 && std::strcmp(argv[3], "-fast") != 0) {
+			std::cerr << "unknown argument: " << argv[3] << '\n';
+			return EXIT_FAILURE;
+		}
+		return Replay::Play(argv[2], argc == 4) ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else if (argc == 3 && std::strcmp(argv[1], "-spectate") == 0) {
+		const bool ok = Spectator::Run(argv[2]);
+		Spectator::PrintStats();
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else if (argc == 3 && std::strcmp(argv[1], "-proxy") == 0) {
+		return Proxy::Run(argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else if (argc >= 3 && std::strcmp(argv[1], "-lobby") == 0) {
+		return Lobby::Run(argv + 2, argc - 2) ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else if (argc == 4 && std::strcmp(argv[1], "-synthetic") == 0) {
+		const auto count = std::atoi(argv[3]);
+		if (count < 2) {
+			std::cerr << "synthetic clients must be 2 or more\n";
+			return EXIT_FAILURE;
+		}
+		return Lobby::Simulate(argv[2], count) ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else if (argc == 3 && std::strcmp(argv[1], "-benchmark") == 0) {
+		return Benchmark::Run(std::atoi(argv[2])) ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else if (argc == 4 && std::strcmp(argv[1], "-batch") == 0) {
+		return Batch::Run(std::atoi(argv[2]), std::atoi(argv[3])) ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else if (argc > 1) {
 		Connection::Mode mode;
+		auto transport = Connection::Transport::Tcp;
 		if (std::strcmp(argv[1], "-server") == 0) {
 			mode = Connection::Mode::Server;
 		} else if (std::strcmp(argv[1], "-client") == 0) {
@@ -109,31 +92,153 @@ int main(int argc, char** argv)
 			std::cerr << "unknown argument: " << argv[1] << '\n';
 			return EXIT_FAILURE;
 		}
-		if (!Connection::Init(mode))
+		for (int i = 2; i < argc; ++i) {
+			if (std::strcmp(argv[i], "-tcp") == 0) {
+				transport = Connection::Transport::Tcp;
+			} else if (std::strcmp(argv[i], "-udp") == 0) {
+				transport = Connection::Transport::Udp;
+			} else if (std::strcmp(argv[i], "-timeout") == 0 && i + 1 < argc) {
+				timeout = static_cast<float>(std::atof(argv[++i]));
+				if (timeout <= 0) {
+					std::cerr << "timeout must be more than 0 seconds\n";
+					return EXIT_FAILURE;
+				}
+			} else if (std::strcmp(argv[i], "-retries") == 0 && i + 1 < argc) {
+				retries = std::atoi(argv[++i]);
+				if (retries < 0) {
+					std::cerr << "retries can't be negative\n";
+					return EXIT_FAILURE;
+				}
+			} else if (std::strcmp(argv[i], "-record") == 0 && i + 1 < argc) {
+				record_path = argv[++i];
+			} else if (std::strcmp(argv[i], "-lobby") == 0 && i + 1 < argc) {
+				lobby_address = argv[++i];
+			} else if (std::strcmp(argv[i], "-interpolate") == 0) {
+				interpolate = true;
+			} else if (std::strcmp(argv[i], "-hud") == 0) {
+				hud = true;
+			} else if (std::strcmp(argv[i], "-stats") == 0 && i + 1 < argc) {
+				stats_interval = static_cast<float>(std::atof(argv[++i]));
+				if (stats_interval <= 0) {
+					std::cerr << "stats interval must be more than 0 seconds\n";
+					return EXIT_FAILURE;
+				}
+			} else if (std::strcmp(argv[i], "-tickrate") == 0 && i + 1 < argc) {
+				tick_rate = static_cast<float>(std::atof(argv[++i]));
+				if (tick_rate < Timestep::kMinRate || tick_rate > Timestep::kMaxRate) {
+					std::cerr << "tick rate must be " << Timestep::kMinRate << " to "
+					          << Timestep::kMaxRate << " ticks a second\n";
+					return EXIT_FAILURE;
+				}
+			} else if (std::strcmp(argv[i], "-fps") == 0 && i + 1 < argc) {
+				frame_limit = std::atoi(argv[++i]);
+				if (frame_limit < 0) {
+					std::cerr << "frame limit can't be negative\n";
+					return EXIT_FAILURE;
+				}
+			} else if (std::strcmp(argv[i], "-vsync") == 0) {
+				vsync = true;
+			} else if (std::strcmp(argv[i], "-rollback") == 0 && i + 1 < argc) {
+				netcode = Netcode::Rollback;
+				netcode_frames = std::atoi(argv[++i]);
+				if (netcode_frames < 1 || netcode_frames > Rollback::kMaxWindow) {
+					std::cerr << "rollback window must be 1 to " << Rollback::kMaxWindow << '\n';
+					return EXIT_FAILURE;
+				}
+			} else if (std::strcmp(argv[i], "-check") == 0 && i + 1 < argc) {
+				check_interval = std::atoi(argv[++i]);
+				if (check_interval < 1 || check_interval > Desync::kMaxInterval) {
+					std::cerr << "check interval must be 1 to " << Desync::kMaxInterval << " frames\n";
+					return EXIT_FAILURE;
+				}
+			} else if (std::strcmp(argv[i], "-delay") == 0 && i + 1 < argc) {
+				netcode = Netcode::InputDelay;
+				netcode_frames = std::atoi(argv[++i]);
+				if (netcode_frames < 0 || netcode_frames > InputDelay::kMaxDelay) {
+					std::cerr << "input delay must be 0 to " << InputDelay::kMaxDelay << '\n';
+					return EXIT_FAILURE;
+				}
+			} else {
+				std::cerr << "unknown argument: " << argv[i] << '\n';
+				return EXIT_FAILURE;
+			}
+		}
+		if (interpolate && netcode != Netcode::Lockstep) {
+			std::cerr << "-interpolate can't be used with a netcode option\n";
+			return EXIT_FAILURE;
+		}
+		// lockstep eases the client's ball into the server's, it is
+		// expected to be off
+		if (check_interval > 0 && netcode == Netcode::Lockstep) {
+			std::cerr << "-check needs -rollback or -delay\n";
+			return EXIT_FAILURE;
+		}
+		// a lobby only sends to dedicated servers
+		if (lobby_address != nullptr && (mode != Connection::Mode::Client ||
+		    transport != Connection::Transport::Tcp || netcode != Netcode::Lockstep)) {
+			std::cerr << "-lobby only goes with a tcp -client without a netcode option\n";
+			return EXIT_FAILURE;
+		}
+		// the network thread greets with it
+		set_tick_rate(tick_rate);
+		if (!Connection::Init(mode, transport, sf::seconds(timeout), retries, lobby_address))
 			return EXIT_FAILURE;
+		if (netcode == Netcode::Lockstep)
+			Lockstep::Init(interpolate);
+		else if (netcode == Netcode::Rollback)
+			Rollback::Init(netcode_frames);
+		else if (netcode == Netcode::InputDelay)
+			InputDelay::Init(netcode_frames);
+		Desync::Init(check_interval);
 	} else {
-		std::cerr << "usage: " << argv[0] << " <mode>\n"
-		          << "mode: -server, -client\n";
+		std::cerr << "usage: " << argv[0] << " <mode> [transport] [netcode] [-interpolate]"
+		          << " [-timeout <seconds>] [-retries <n>] [-record <file>]\n"
+		          << "       [-hud] [-stats <seconds>] [-lobby <address>] [-tickrate <hz>] [-fps <n>] [-vsync]\n"
+		          << "mode: -server, -client, -dedicated [-record <dir>], -spectate <address>,\n"
+		          << "      -replay <file> [-fast], -proxy <profile>, -lobby <server>...,\n"
+		          << "      -synthetic <address> <clients>, -benchmark <frames>,\n"
+		          << "      -batch <matches> <frames>\n"
+		          << "transport: -tcp (default), -udp\n"
+		          << "netcode: -rollback <frames>, -delay <frames>, either with -check <frames>\n";
 		return EXIT_FAILURE;
 	}
 
+	auto state = initial_state(Connection::is_server);
 	Shapes shapes;
-	Positions positions;
-	Velocities velocities;
+	// the keys' paddle velocity, handed to the netcode every tick
+	float input {0.f};
+	// the window opens while the network thread connects, startup times
+	// are taken from here
+	const sf::Clock startup_clock;
+	sf::Time window_time, connect_time, first_frame_time;
+	bool handshake_done {false};
+	sf::Uint32 session {0};
+	bool resyncing {false};
 	sf::RenderWindow window({kWinWidth, kWinHeight}, "PongOn");
 	sf::Event event;
 
-	set_initial_positions(&shapes.local, &shapes.remote);
+	if (record_path != nullptr && !Replay::Open(record_path, state, &Replay::recorder))
+		return EXIT_FAILURE;
 
-	window.setFramerateLimit(60);
+	// vsync paces the window by itself, a limit on top would fight it
+	if (vsync)
+		window.setVerticalSyncEnabled(true);
+	else
+		window.setFramerateLimit(static_cast<unsigned int>(frame_limit));
+	window_time = startup_clock.getElapsedTime();
+	Hud::Init(hud, stats_interval);
+	Timestep::Init(tick_rate);
 	while (window.isOpen()) {
 		while (window.pollEvent(event)) {
 			switch (event.type) {
 			case sf::Event::KeyPressed:
-				process_input(event.key.code, true, &velocities);
+				if (event.key.code == Hud::kToggleKey)
+					Hud::Toggle();
+				else
+					process_input(event.key.code, true, &input);
 				break;
 			case sf::Event::KeyReleased:
-				process_input(event.key.code, false, &velocities);
+				process_input(event.key.code, false, &input);
 				break;
 			case sf::Event::Closed:
 				window.close();
@@ -142,118 +247,139 @@ int main(int argc, char** argv)
 				break;
 			}
 		}
-		
-		Connection::UpdateChat();
 
-		update_positions(shapes, &positions);
-		update_velocities(positions, &velocities);
-		
-		if (!Connection::Exchange(velocities.local, &velocities.remote)) {
+		// every tick of the frame sees the same input, the netcode's
+		// update is one tick. one that had to wait for the peer leaves the
+		// rest to the next frame, which would likely wait as well
+		bool connected {true};
+		for (auto ticks = Timestep::Due(); ticks > 0 && connected; --ticks) {
+			if (!handshake_done) {
+				connected = Connection::Handshake(&handshake_done);
+				if (handshake_done) {
+					connect_time = startup_clock.getElapsedTime();
+					session = Connection::Session();
+				}
+			} else if (Connection::Reconnecting()) {
+				// the game waits where it was, the window keeps responding
+				connected = true;
+			} else if (resyncing || session != Connection::Session()) {
+				if (!resyncing) {
+					session = Connection::Session();
+					Connection::BeginSession();
+				}
+				bool done;
+				connected = resync(netcode, &state, &done);
+				resyncing = !done;
+			} else {
+				// a tick allocates nothing, chat included, debug builds check it
+				const auto allocations = Allocations::Count();
+				const auto frames = simulated_frames(netcode);
+				if (netcode == Netcode::Rollback)
+					connected = Rollback::Update(input, &state);
+				else if (netcode == Netcode::InputDelay)
+					connected = InputDelay::Update(input, &state);
+				else
+					connected = Lockstep::Update(input, &state);
+				Allocations::AssertNone(allocations);
+				if (simulated_frames(netcode) == frames)
+					break;
+			}
+		}
+
+		if (!connected) {
 			std::cerr << "Connection error: " << Connection::status << '\n';
 			break;
 		}
 		
-		update_shapes(velocities, &shapes);
-		
+		Hud::Update(simulated_frames(netcode));
+		update_shapes(state, &shapes);
 		window.clear(sf::Color::Blue);
 		window.draw(shapes.ball);
 		window.draw(shapes.local);
 		window.draw(shapes.remote);
+		Hud::Draw(&window);
 		window.display();
+
+		if (first_frame_time == sf::Time::Zero && handshake_done && simulated_frames(netcode) > 0)
+			first_frame_time = startup_clock.getElapsedTime();
 	}
 
+	std::cout << "startup: window in " << window_time.asMilliseconds() << " ms";
+	if (connect_time != sf::Time::Zero)
+		std::cout << ", connected in " << connect_time.asMilliseconds() << " ms";
+	if (first_frame_time != sf::Time::Zero)
+		std::cout << ", first frame in " << first_frame_time.asMilliseconds() << " ms";
+	std::cout << '\n';
+
+	if (netcode == Netcode::Lockstep)
+		Lockstep::PrintStats();
+	else if (netcode == Netcode::Rollback)
+		Rollback::PrintStats();
+	else if (netcode == Netcode::InputDelay)
+		InputDelay::PrintStats();
+	Desync::PrintStats();
+	Timestep::PrintStats();
+	Connection::PrintStats();
+
+	Replay::Close(&Replay::recorder);
 	Connection::Close();
 	return EXIT_SUCCESS;
 }
 
 
-void set_initial_positions(Paddle* const local, Paddle* const remote)
+sf::Uint32 simulated_frames(const Netcode netcode)
 {
-	constexpr const auto middleScreen = kWinHeight / 2.f;
-	constexpr const auto left = kPaddleWidth / 2.f;
-	constexpr const auto right = kWinWidth - (kPaddleWidth) / 2.f;
-
-	if (Connection::is_server) {
-		local->setPosition(left, middleScreen);
-		remote->setPosition(right, middleScreen);
-	} else {
-		local->setPosition(right, middleScreen);
-		remote->setPosition(left, middleScreen);
+	switch (netcode) {
+	case Netcode::Rollback: return Rollback::stats.frames;
+	case Netcode::InputDelay: return InputDelay::stats.frames;
+	default: return Lockstep::stats.frames;
 	}
 }
 
-void update_positions(const Shapes& shapes, Positions* const positions)
+// after a reconnection the server sends the whole state as the first
+// message of the new session, both sides load it and run their netcode
+// from frame 0 again. the client keeps polling until it is there
+bool resync(const Netcode netcode, GameState* const state, bool* const done)
 {
-	const auto update =
-	[](const sf::Shape& shape, Position& pos, float width, float height) {
-		const auto width_diff = width / 2.f;
-		const auto height_diff = height / 2.f;
-		const auto shapePos = shape.getPosition();
-		pos.right = shapePos.x + width_diff;
-		pos.left = shapePos.x - width_diff;
-		pos.bottom = shapePos.y + height_diff;
-		pos.top = shapePos.y - height_diff;
-	};
-	update(shapes.ball, positions->ball, kBallRadius, kBallRadius);
-	update(shapes.local, positions->local, kPaddleWidth, kPaddleHeight);
-	update(shapes.remote, positions->remote, kPaddleWidth, kPaddleHeight);
-}
-
-
-void update_velocities(const Positions& positions, Velocities* const velocities)
-{	
-	const auto& ballpos = positions.ball;
-	auto& ballvel = velocities->ball;
-	
-	const auto collided = [&ballpos](const auto& paddle) {
-		return (ballpos.right >= paddle.left && ballpos.left <= paddle.right)
-		&& (ballpos.bottom >= paddle.top && ballpos.top <= paddle.bottom);
-	};
-	
-	if (collided(positions.local) || collided(positions.remote)) {
-		ballvel.x = -ballvel.x;
+	char payload[Connection::kMaxPayloadSize];
+	auto received = *state;
+	*done = false;
+	if (Connection::is_server) {
+		received.local.velocity = to_scalar(0.f);
+		received.remote.velocity = to_scalar(0.f);
+		if (!Connection::SendMessage(payload, write_state(received, payload)))
+			return false;
 	} else {
-		if (ballpos.left < 0)
-			ballvel.x = std::abs(ballvel.x);
-		else if (ballpos.right > kWinWidth)
-			ballvel.x = -std::abs(ballvel.x);
-
-		if (ballpos.top < 0)
-			ballvel.y = std::abs(ballvel.y);
-		else if (ballpos.bottom > kWinHeight)
-			ballvel.y = -std::abs(ballvel.y);
-	}
-		
-	if (velocities->local) {
-		const auto& pos = positions.local;
-		auto& vel = velocities->local;
-		if (vel < 0 && pos.top <= 0)
-			vel = 0;
-		else if (vel > 0 && pos.bottom >= kWinHeight)
-			vel = 0;
+		std::size_t size;
+		if (!Connection::ReceiveMessage(payload, sizeof(payload), &size))
+			return false;
+		if (size == 0)
+			return true;
+		if (!read_state(payload, size, &received)) {
+			Connection::status = sf::Socket::Error;
+			return false;
+		}
+		// the paddles stay on their sides, only where they are is swapped
+		std::swap(received.local.y, received.remote.y);
 	}
-}
 
-void update_shapes(const Velocities& velocities, Shapes* const shapes)
-{
-	if (velocities.ball != sf::Vector2f{0, 0})
-		shapes->ball.setPosition(shapes->ball.getPosition() + velocities.ball);
-	
-	if (velocities.local) {
-		const auto& pos = shapes->local.getPosition();
-		shapes->local.setPosition(pos.x, pos.y + velocities.local);
-	}
-	
-	if (velocities.remote) {
-		const auto& pos = shapes->remote.getPosition();
-		shapes->remote.setPosition(pos.x, pos.y + velocities.remote);
-	}
+	received.frame = 0;
+	*state = received;
+	Replay::Resync(received, &Replay::recorder);
+	if (netcode == Netcode::Rollback)
+		Rollback::Restart();
+	else if (netcode == Netcode::InputDelay)
+		InputDelay::Restart();
+	else
+		Lockstep::Restart();
+	std::cout << "resynced\n";
+	*done = true;
+	return true;
 }
 
-
-void process_input(const sf::Keyboard::Key code, const bool pressed, Velocities* const velocities)
+void process_input(const sf::Keyboard::Key code, const bool pressed, float* const velocity)
 {
-	float& vel = velocities->local;
+	float& vel = *velocity;
 	if (pressed) {
 		switch (code) {
 		case sf::Keyboard::W: vel = -kPaddleVelocity; break;
@@ -265,173 +391,3 @@ void process_input(const sf::Keyboard::Key code, const bool pressed, Velocities*
 	}
 }
 
-
-bool Connection::Init(const Mode mode)
-{
-	is_running = false;
-	is_server = mode == Mode::Server;
-	do {
-		std::cout << "enter your nickname: ";
-		std::getline(std::cin, local_nick);
-	} while (local_nick.size() == 0);
-	
-	if (local_nick.size() > 10)
-		local_nick.resize(10);
-
-	if (is_server) {
-		sf::TcpListener listener;
-		std::cout << "booting as server...\n";
-		if (listener.listen(kPort) != sf::Socket::Done) {
-			std::cerr << "failed to listen port " << kPort << '\n';
-			return false;
-		}
-		
-		std::cout << "waiting for client...\n"; 
-		if (listener.accept(socket) != sf::Socket::Done) {
-			std::cerr << "connection failed\n";
-			return false;
-		}
-	} else {
-		sf::IpAddress serverIp;
-		std::cout << "booting as client...\n";
-		std::cout << "enter the server\'s ip address: ";
-		std::cin >> serverIp;
-		if (socket.connect(serverIp, kPort) != sf::Socket::Done) {
-			std::cerr << "connection failed!\n";
-			return false;
-		}
-	}
-
-	sf::Packet send_pack, receive_pack;
-	send_pack << local_nick;
-	
-	if (!Exchange(&send_pack, &receive_pack)) {
-		std::cerr << "failed to exchange nicks\n";
-		return false;
-	}
-
-	receive_pack >> remote_nick;
-	std::cout << "connected to: " << remote_nick << '\n';
-	chat_msgs.reserve(100);
-	PrintChat();
-
-	is_running = true;
-	stdin_updater = std::thread([] {
-		std::string aux_str;
-		while (is_running) {
-			if (sending_msg == "") {
-				std::getline(std::cin, aux_str);
-				if (aux_str != "" && aux_str != " " &&
-				  aux_str != "\n" && aux_str != "\t" &&
-				  aux_str != "\0") {
-					sending_msg = std::move(aux_str);
-				}
-			}
-		}
-	});
-
-	stdin_updater.detach();
-	return true;
-}
-
-void Connection::Close()
-{
-	// wait for threads to finish
-	socket.disconnect();
-	is_running = false;
-	if (stdin_updater.joinable())
-		stdin_updater.join();
-}
-
-template<class ...Args>
-bool Connection::Send(Args&& ...args)
-{
-	status = socket.send(std::forward<Args>(args)...);
-	return status == sf::Socket::Done;
-}
-
-template<class ...Args>
-bool Connection::Receive(Args&& ...args)
-{
-	status = socket.receive(std::forward<Args>(args)...);
-	return status == sf::Socket::Done;
-}
-
-template<class Data>
-bool Connection::Exchange(const Data sending, Data* const receiving) 
-{
-	return ExchangeFun([=]{return Send(&sending, sizeof(Data));},
-                        [=]{return Receive(receiving, sizeof(Data), bytes_received);});
-}
-
-bool Connection::Exchange(sf::Packet* const send, sf::Packet* const receive)
-{
-	return ExchangeFun([=]{return Send(*send);},
-			[=]{return Receive(*receive);});
-}
-
-template<class SendFunc, class ReceiveFunc>
-bool Connection::ExchangeFun(const SendFunc send, const ReceiveFunc receive)
-{
-	if (is_server)
-		return send() && receive();
-	else
-		return receive() && send();
-}
-
-
-void Connection::UpdateChat()
-{
-	const auto old_chat_msgs_size = chat_msgs.size();
-	sf::Packet receive_pack, send_pack;
-	
-	if (sending_msg != "") {
-		if (sending_msg.size() > 50)
-			sending_msg = sending_msg.substr(0, 50);
-		const auto fmt_msg = local_nick + ":> " + sending_msg;
-		send_pack << fmt_msg;
-		chat_msgs.push_back(std::move(fmt_msg));
-		sending_msg = "";
-	}
-
-	Exchange(&send_pack, &receive_pack);
-	receive_pack >> receiving_msg;
-
-	if (receiving_msg != "") {
-		chat_msgs.push_back(std::move(receiving_msg));
-		receiving_msg = "";
-	}
-
-	if (old_chat_msgs_size != chat_msgs.size())
-		PrintChat();
-}
-
-
-void Connection::PrintChat()
-{
-#ifdef __linux__
-	std::system("clear");
-#elif defined(_WIN32)
-	std::system("cls");
-#endif
-
-	std::string aux_str;
-	auto chat_msgs_size = chat_msgs.size();
-	if (chat_msgs_size >= 100) {
-		std::move(chat_msgs.begin() + 80, chat_msgs.end(),
-		  chat_msgs.begin());
-		chat_msgs.erase(chat_msgs.begin() + 20, chat_msgs.end());
-		chat_msgs_size = 20;
-	}
-
-	auto line = chat_msgs_size < 20 ? 0 : chat_msgs_size - 20;
-	for (; line < chat_msgs_size; ++line)
-		aux_str += chat_msgs[line] + "\n";
-	for (; line < 20; ++line)
-		aux_str += "\n";
-	
-	std::cout << "======================== CHAT ========================\n"
-	          << std::move(aux_str)
-	          << "======================== CHAT ========================\n";
-}
-
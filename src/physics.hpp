@@ -0,0 +1,231 @@
+#ifndef PONGON_PHYSICS_HPP_
+#define PONGON_PHYSICS_HPP_
+#include <cmath>
+#include <algorithm>
+
+#include <SFML/System.hpp>
+
+#include "fixed_point.hpp"
+#include "schema.hpp"
+#include "simulation.hpp"
+
+// the frame step runs, written once over the number type it is done in.
+// with FixedPoint every step is integer math, so any build, -O0 or -O3,
+// on any cpu gets the same state from the same inputs, which the netcodes
+// running from the inputs alone and replays rely on. building with
+// PONGON_FIXED_POINT_ picks it over float.
+// the ball is swept along its velocity as a circle, half as wide as it is
+// drawn, against the walls and the paddles, so it bounces at the exact
+// time it touches one and can't pass through a paddle however fast it
+// goes. products stay within FixedPoint's 64 bits for speeds up to about
+// 100 pixels a frame. kTag tells which numbers a peer simulates in and
+// kRevision which rules
+namespace Physics {
+	template<class T>
+	struct Number;
+
+	template<>
+	struct Number<float> {
+		static constexpr sf::Uint32 kTag {0};
+		static constexpr float FromFloat(const float value) { return value; }
+		static constexpr float ToFloat(const float value) { return value; }
+	};
+
+	template<int FracBits>
+	struct Number<FixedPoint<FracBits>> {
+		static constexpr sf::Uint32 kTag {FracBits};
+		static constexpr FixedPoint<FracBits> FromFloat(const float value)
+		{
+			return FixedPoint<FracBits>::FromFloat(value);
+		}
+		static constexpr float ToFloat(const FixedPoint<FracBits> value)
+		{
+			return value.ToFloat();
+		}
+	};
+
+	// GameState's numbers, the ones steps are done in
+	using Scalar = ::Scalar;
+	// bumped when the same inputs give another frame
+	constexpr const sf::Uint32 kRevision {1};
+	constexpr const sf::Uint32 kTag {Schema::Tag({kRevision, Number<Scalar>::kTag})};
+	// surfaces the ball bounces off in one frame at most, the rest of the
+	// frame is dropped, when it is wedged between a paddle and a wall
+	constexpr const int kMaxBounces {4};
+
+	template<class T>
+	struct State {
+		T ball_x, ball_y;
+		T ball_velocity_x, ball_velocity_y;
+		T local_x, local_y, local_velocity;
+		T remote_x, remote_y, remote_velocity;
+	};
+
+	// a wall or a paddle's face flips one velocity component, a paddle's
+	// corner reflects the velocity about the normal there
+	enum class Surface {None, X, Y, Corner};
+
+	// the earliest the ball touches something, in frames. the normal is
+	// the corner's, from it to the ball's center, as long as the radius
+	template<class T>
+	struct Contact {
+		T time;
+		Surface surface;
+		T normal_x, normal_y;
+	};
+
+	template<class T>
+	constexpr const T kZero {Number<T>::FromFloat(0.f)};
+	template<class T>
+	constexpr const T kRadius {Number<T>::FromFloat(kBallRadius / 2.f)};
+
+	template<class T>
+	void Touch(const T time, const Surface surface, Contact<T>* const contact)
+	{
+		if (time < contact->time)
+			*contact = {time, surface, kZero<T>, kZero<T>};
+	}
+
+	// distance d along an axis with velocity v closing in
+	template<class T>
+	bool Closing(const T d, const T v)
+	{
+		return (d < kZero<T> && v > kZero<T>) || (d > kZero<T> && v < kZero<T>);
+	}
+
+	// one heading out of the screen already bounces right away
+	template<class T>
+	void SweepWalls(const State<T>& s, Contact<T>* const contact)
+	{
+		constexpr const T width {Number<T>::FromFloat(kWinWidth)};
+		constexpr const T height {Number<T>::FromFloat(kWinHeight)};
+		constexpr const auto r = kRadius<T>;
+		const auto vx = s.ball_velocity_x;
+		const auto vy = s.ball_velocity_y;
+
+		if (vx < kZero<T>)
+			Touch(std::max(kZero<T>, (r - s.ball_x) / vx), Surface::X, contact);
+		else if (vx > kZero<T>)
+			Touch(std::max(kZero<T>, (width - r - s.ball_x) / vx), Surface::X, contact);
+
+		if (vy < kZero<T>)
+			Touch(std::max(kZero<T>, (r - s.ball_y) / vy), Surface::Y, contact);
+		else if (vy > kZero<T>)
+			Touch(std::max(kZero<T>, (height - r - s.ball_y) / vy), Surface::Y, contact);
+	}
+
+	// the circle against the paddle's box: one of its faces, moved out by
+	// the radius, or one of its corners, rounded by it. the ball only ends up
+	// inside when the paddle moves onto it, it then leaves the way it was
+	// going, flipping it there could trap it against the wall behind
+	template<class T>
+	void SweepPaddle(const State<T>& s, const T x, const T y, Contact<T>* const contact)
+	{
+		using std::abs;
+		using std::sqrt;
+		constexpr const T half_width {Number<T>::FromFloat(kPaddleWidth / 2.f)};
+		constexpr const T half_height {Number<T>::FromFloat(kPaddleHeight / 2.f)};
+		constexpr const auto r = kRadius<T>;
+		const auto vx = s.ball_velocity_x;
+		const auto vy = s.ball_velocity_y;
+		const T dx {s.ball_x - x};
+		const T dy {s.ball_y - y};
+
+		// out of reach this frame
+		const auto time = contact->time;
+		if (abs(dx) - abs(vx) * time > half_width + r || abs(dy) - abs(vy) * time > half_height + r)
+			return;
+
+		const auto outside_x = std::max(kZero<T>, abs(dx) - half_width);
+		const auto outside_y = std::max(kZero<T>, abs(dy) - half_height);
+		if (outside_x * outside_x + outside_y * outside_y < r * r)
+			return;
+
+		if (Closing(dx, vx)) {
+			const T face {dx < kZero<T> ? -(half_width + r) : half_width + r};
+			const T hit {(face - dx) / vx};
+			if (hit >= kZero<T> && abs(dy + vy * hit) <= half_height)
+				Touch(hit, Surface::X, contact);
+		}
+		if (Closing(dy, vy)) {
+			const T face {dy < kZero<T> ? -(half_height + r) : half_height + r};
+			const T hit {(face - dy) / vy};
+			if (hit >= kZero<T> && abs(dx + vx * hit) <= half_width)
+				Touch(hit, Surface::Y, contact);
+		}
+
+		// a corner the ball isn't closing in on is skipped before the root
+		const T a {vx * vx + vy * vy};
+		for (const auto corner_x : {-half_width, half_width}) {
+			for (const auto corner_y : {-half_height, half_height}) {
+				const T ox {dx - corner_x};
+				const T oy {dy - corner_y};
+				const T b {ox * vx + oy * vy};
+				if (b >= kZero<T>)
+					continue;
+				const T discriminant {b * b - a * (ox * ox + oy * oy - r * r)};
+				if (discriminant < kZero<T>)
+					continue;
+				const T hit {(-b - sqrt(discriminant)) / a};
+				if (hit < kZero<T> || hit >= contact->time)
+					continue;
+				if (abs(dx + vx * hit) > half_width && abs(dy + vy * hit) > half_height)
+					*contact = {hit, Surface::Corner, ox + vx * hit, oy + vy * hit};
+			}
+		}
+	}
+
+	// a paddle stops at the walls
+	template<class T>
+	T Clamp(const T y, const T velocity)
+	{
+		constexpr const T height {Number<T>::FromFloat(kWinHeight)};
+		constexpr const T half_height {Number<T>::FromFloat(kPaddleHeight / 2.f)};
+		if (velocity < kZero<T> && y - half_height <= kZero<T>)
+			return kZero<T>;
+		else if (velocity > kZero<T> && y + half_height >= height)
+			return kZero<T>;
+		return velocity;
+	}
+
+	// the paddles are clamped against the walls and, like the ball, swept
+	// against where they start the frame, then moved. dt is the frame's
+	// length in base ticks, the unit of the velocities
+	template<class T>
+	void Step(const T dt, State<T>* const state)
+	{
+		auto& s = *state;
+
+		s.local_velocity = Clamp(s.local_y, s.local_velocity);
+		s.remote_velocity = Clamp(s.remote_y, s.remote_velocity);
+
+		auto left = dt;
+		for (int bounces = 0; bounces < kMaxBounces && left > kZero<T>; ++bounces) {
+			Contact<T> contact {left, Surface::None, kZero<T>, kZero<T>};
+			SweepWalls(s, &contact);
+			SweepPaddle(s, s.local_x, s.local_y, &contact);
+			SweepPaddle(s, s.remote_x, s.remote_y, &contact);
+			s.ball_x += s.ball_velocity_x * contact.time;
+			s.ball_y += s.ball_velocity_y * contact.time;
+			left -= contact.time;
+			if (contact.surface == Surface::X) {
+				s.ball_velocity_x = -s.ball_velocity_x;
+			} else if (contact.surface == Surface::Y) {
+				s.ball_velocity_y = -s.ball_velocity_y;
+			} else if (contact.surface == Surface::Corner) {
+				const auto nx = contact.normal_x;
+				const auto ny = contact.normal_y;
+				const auto along = (s.ball_velocity_x * nx + s.ball_velocity_y * ny) / (nx * nx + ny * ny);
+				s.ball_velocity_x -= (along + along) * nx;
+				s.ball_velocity_y -= (along + along) * ny;
+			}
+		}
+
+		if (s.local_velocity != kZero<T>)
+			s.local_y += s.local_velocity * dt;
+		if (s.remote_velocity != kZero<T>)
+			s.remote_y += s.remote_velocity * dt;
+	}
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include "poller.hpp"
+
+namespace Poller {
+#ifdef __linux__
+	static bool Add(sf::SocketHandle handle, void* owner, Set* set);
+#else
+	static bool Add(sf::Socket* socket, void* owner, Set* set);
+#endif
+}
+
+
+bool Poller::Init(Set* const set)
+{
+#ifdef __linux__
+	set->epoll_fd = epoll_create1(0);
+	return set->epoll_fd >= 0;
+#else
+	static_cast<void>(set);
+	return true;
+#endif
+}
+
+bool Poller::Watch(Listener* const listener, void* const owner, Set* const set)
+{
+#ifdef __linux__
+	return Add(listener->getHandle(), owner, set);
+#else
+	return Add(listener, owner, set);
+#endif
+}
+
+bool Poller::Watch(Socket* const socket, void* const owner, Set* const set)
+{
+#ifdef __linux__
+	return Add(socket->getHandle(), owner, set);
+#else
+	return Add(socket, owner, set);
+#endif
+}
+
+void Poller::Unwatch(Socket* const socket, Set* const set)
+{
+#ifdef __linux__
+	epoll_event event {};
+	epoll_ctl(set->epoll_fd, EPOLL_CTL_DEL, socket->getHandle(), &event);
+#else
+	set->selector.remove(*socket);
+	set->watched.erase(std::remove_if(set->watched.begin(), set->watched.end(),
+	                                  [socket](const Set::Watched& watched) { return watched.socket == socket; }),
+	                   set->watched.end());
+#endif
+}
+
+int Poller::Wait(const sf::Time timeout, Set* const set, void** const ready)
+{
+#ifdef __linux__
+	epoll_event events[kMaxReady];
+	const auto timeout_ms = static_cast<int>((timeout.asMicroseconds() + 999) / 1000);
+	const auto count = epoll_wait(set->epoll_fd, events, kMaxReady, timeout_ms);
+	for (int i = 0; i < count; ++i)
+		ready[i] = events[i].data.ptr;
+	return std::max(count, 0);
+#else
+	// a zero timeout would wait forever
+	if (!set->selector.wait(std::max(timeout, sf::microseconds(1))))
+		return 0;
+
+	int count {0};
+	for (const auto& watched : set->watched) {
+		if (count < kMaxReady && set->selector.isReady(*watched.socket))
+			ready[count++] = watched.owner;
+	}
+	return count;
+#endif
+}
+
+#ifdef __linux__
+bool Poller::Add(const sf::SocketHandle handle, void* const owner, Set* const set)
+{
+	epoll_event event {};
+	event.events = EPOLLIN;
+	event.data.ptr = owner;
+	return epoll_ctl(set->epoll_fd, EPOLL_CTL_ADD, handle, &event) == 0;
+}
+#else
+bool Poller::Add(sf::Socket* const socket, void* const owner, Set* const set)
+{
+	set->selector.add(*socket);
+	set->watched.push_back({socket, owner});
+	return true;
+}
+#endif
@@ -0,0 +1,47 @@
+#ifndef PONGON_POLLER_HPP_
+#define PONGON_POLLER_HPP_
+#include <vector>
+
+#include <SFML/Network.hpp>
+
+// waits on many sockets at once for the dedicated server and the lobby.
+// epoll on linux, elsewhere an sf::SocketSelector, select based, so
+// limited to FD_SETSIZE sockets. each socket is watched with an owner
+// pointer, which is what a wait hands back once it can be read
+namespace Poller {
+	// the most owners a wait hands back, the rest come with the next one
+	constexpr const int kMaxReady {256};
+
+	// the native handles are needed to register the sockets with epoll
+	struct Socket : sf::TcpSocket {
+		using sf::TcpSocket::getHandle;
+	};
+
+	struct Listener : sf::TcpListener {
+		using sf::TcpListener::getHandle;
+	};
+
+	struct Set {
+#ifdef __linux__
+		int epoll_fd {-1};
+#else
+		struct Watched {
+			sf::Socket* socket;
+			void* owner;
+		};
+
+		sf::SocketSelector selector;
+		std::vector<Watched> watched;
+#endif
+	};
+
+	bool Init(Set* set);
+	bool Watch(Listener* listener, void* owner, Set* set);
+	bool Watch(Socket* socket, void* owner, Set* set);
+	void Unwatch(Socket* socket, Set* set);
+	// the owners of up to kMaxReady sockets ready to be read, waiting up to
+	// timeout for one. returns how many
+	int Wait(sf::Time timeout, Set* set, void** ready);
+}
+
+#endif
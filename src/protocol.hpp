@@ -0,0 +1,39 @@
+#ifndef PONGON_PROTOCOL_HPP_
+#define PONGON_PROTOCOL_HPP_
+#include <SFML/System.hpp>
+
+#include "desync.hpp"
+#include "game.hpp"
+#include "input_queue.hpp"
+#include "lobby.hpp"
+#include "lockstep.hpp"
+#include "physics.hpp"
+#include "schema.hpp"
+
+// what both ends of a connection must agree on. the greeting carries Tag,
+// kTag with the tick rate mixed in. kTag changes with kVersion, bumped
+// when a hand written part of a message changes, and with the layout of
+// every schema, so a peer built with other messages, simulating in other
+// numbers or stepping at another rate, is turned away instead of misread
+namespace Protocol {
+	constexpr const sf::Uint32 kVersion {4};
+	constexpr const sf::Uint32 kTag {Schema::Tag({
+		kVersion,
+		Physics::kTag,
+		StateSchema::kTag,
+		Lockstep::HeadSchema::kTag,
+		Lockstep::PaddleSchema::kTag,
+		Lockstep::SnapshotSchema::kTag,
+		InputQueue::HeaderSchema::kTag,
+		Desync::CheckSchema::kTag,
+		Desync::DumpSchema::kTag,
+		Lobby::TicketSchema::kTag
+	})};
+
+	constexpr sf::Uint32 Tag(const float tick_rate)
+	{
+		return Schema::Tag({kTag, Schema::Parameter(tick_rate)});
+	}
+}
+
+#endif
@@ -0,0 +1,357 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <SFML/Network.hpp>
+
+#include "connection.hpp"
+#include "proxy.hpp"
+
+namespace Proxy {
+	// up goes from the client to the server
+	enum Direction {Up, Down, DirectionCount};
+
+	struct Packet {
+		sf::Int64 release;
+		std::vector<char> data;
+	};
+
+	// one way of the link. datagrams leave when their time comes, in
+	// whatever order that gives, tcp chunks always in the order they came
+	struct Link {
+		std::vector<Packet> datagrams;
+		std::deque<Packet> chunks;
+		std::size_t chunk_sent;
+		sf::Int64 busy_until;
+		sf::Int64 last_release;
+		sf::Uint64 packets;
+		sf::Uint64 bytes;
+		sf::Uint64 lost;
+		sf::Uint64 reordered;
+	};
+
+	struct Profile {
+		const char* name;
+		std::vector<Phase> phases;
+	};
+
+	constexpr const std::size_t kChunkSize {4096};
+	static const Profile kProfiles[] {
+		{"lan", {{0, {1, 0.5f, 0, 0, 0}}}},
+		{"wifi", {{0, {15, 8, 1, 0.5f, 0}}}},
+		{"mobile", {{0, {60, 25, 3, 2, 1000}}}},
+		{"bad", {{0, {150, 60, 10, 5, 256}}}},
+		{"spikes", {{4, {30, 5, 0, 0, 0}}, {1, {300, 50, 20, 5, 0}}}},
+	};
+
+	static std::vector<Phase> phases;
+	static Link links[DirectionCount];
+	// always the same seed, so a run can be repeated
+	static std::mt19937 random_engine {kPort};
+	static const sf::Clock clock;
+	static sf::TcpListener listener;
+	static sf::TcpSocket tcp_sockets[DirectionCount];
+	static bool tcp_connected;
+	static sf::UdpSocket udp_socket;
+	static sf::IpAddress udp_client_ip;
+	static unsigned short udp_client_port;
+	static bool has_udp_client;
+
+	static bool Load(const std::string& profile);
+	static std::size_t CurrentPhase();
+	static void Schedule(Direction direction, const char* data, std::size_t size, bool tcp);
+	static void AcceptTcp(sf::SocketSelector* selector);
+	static void CloseTcp(sf::SocketSelector* selector);
+	static bool ReadTcp(Direction direction);
+	static bool WriteTcp(Direction direction);
+	static void ReadUdp();
+	static void WriteUdp(Direction direction);
+	static void PrintStats();
+	static sf::Int64 Now();
+	static bool Chance(float percent);
+}
+
+
+bool Proxy::Run(const char* const profile)
+{
+	if (!Load(profile)) {
+		std::cerr << "unknown profile: " << profile << '\n';
+		return false;
+	}
+
+	if (listener.listen(kPort) != sf::Socket::Done || udp_socket.bind(kPort) != sf::Socket::Done) {
+		std::cerr << "failed to listen port " << kPort << '\n';
+		return false;
+	}
+
+	listener.setBlocking(false);
+	udp_socket.setBlocking(false);
+	sf::SocketSelector selector;
+	selector.add(listener);
+	selector.add(udp_socket);
+
+	std::cout << "proxy on port " << kPort << " forwarding to port " << Connection::kPort
+	          << ", profile " << profile << " with " << phases.size() << " phases\n";
+
+	sf::Clock stats_clock;
+	for (;;) {
+		if (!tcp_connected && selector.isReady(listener))
+			AcceptTcp(&selector);
+
+		if (tcp_connected) {
+			for (const auto direction : {Up, Down}) {
+				if (!ReadTcp(direction) || !WriteTcp(direction)) {
+					CloseTcp(&selector);
+					break;
+				}
+			}
+		}
+
+		ReadUdp();
+		WriteUdp(Up);
+		WriteUdp(Down);
+
+		if (stats_clock.getElapsedTime().asSeconds() >= kStatsInterval) {
+			PrintStats();
+			stats_clock.restart();
+		}
+
+		selector.wait(sf::milliseconds(1));
+	}
+}
+
+bool Proxy::Load(const std::string& profile)
+{
+	for (const auto& builtin : kProfiles) {
+		if (profile == builtin.name) {
+			phases = builtin.phases;
+			return true;
+		}
+	}
+
+	std::ifstream file(profile);
+	std::string line;
+	while (std::getline(file, line)) {
+		line = line.substr(0, line.find('#'));
+		std::istringstream fields(line);
+		Phase phase;
+		auto& settings = phase.settings;
+		if (fields >> phase.duration >> settings.latency >> settings.jitter
+		           >> settings.loss >> settings.reorder >> settings.bandwidth) {
+			phases.push_back(phase);
+		}
+	}
+
+	return !phases.empty();
+}
+
+std::size_t Proxy::CurrentPhase()
+{
+	float total = 0;
+	for (const auto& phase : phases) {
+		if (phase.duration <= 0) {
+			total = 0;
+			break;
+		}
+		total += phase.duration;
+	}
+
+	auto elapsed = clock.getElapsedTime().asSeconds();
+	if (total > 0)
+		elapsed = std::fmod(elapsed, total);
+
+	for (std::size_t i = 0; i < phases.size(); ++i) {
+		if (phases[i].duration <= 0 || elapsed < phases[i].duration)
+			return i;
+		elapsed -= phases[i].duration;
+	}
+	return phases.size() - 1;
+}
+
+// the packet first waits for the bandwidth to let it out, then travels
+// for the latency plus or minus the jitter
+void Proxy::Schedule(const Direction direction, const char* const data, const std::size_t size, const bool tcp)
+{
+	const auto& settings = phases[CurrentPhase()].settings;
+	auto& link = links[direction];
+	const auto now = Now();
+	++link.packets;
+	link.bytes += size;
+
+	auto departure = now;
+	if (settings.bandwidth > 0) {
+		departure = std::max(now, link.busy_until) +
+		            static_cast<sf::Int64>(size * 8 * 1000 / settings.bandwidth);
+		link.busy_until = departure;
+	}
+
+	std::uniform_real_distribution<float> jitter(-settings.jitter, settings.jitter);
+	auto delay = std::max(0.f, settings.latency + jitter(random_engine));
+	if (Chance(settings.loss)) {
+		++link.lost;
+		if (!tcp)
+			return;
+		delay += std::max(kMinRetransmit, 2 * settings.latency);
+	} else if (!tcp && Chance(settings.reorder)) {
+		++link.reordered;
+		delay += kReorderDelay;
+	}
+
+	Packet packet {departure + static_cast<sf::Int64>(delay * 1000), std::vector<char>(data, data + size)};
+	if (tcp) {
+		packet.release = std::max(packet.release, link.last_release);
+		link.last_release = packet.release;
+		link.chunks.push_back(std::move(packet));
+	} else {
+		link.datagrams.push_back(std::move(packet));
+	}
+}
+
+// one connection at a time, the proxy connects to the server only once
+// a client connected to it
+void Proxy::AcceptTcp(sf::SocketSelector* const selector)
+{
+	auto& client = tcp_sockets[Up];
+	auto& server = tcp_sockets[Down];
+	if (listener.accept(client) != sf::Socket::Done)
+		return;
+
+	if (server.connect(sf::IpAddress::LocalHost, Connection::kPort, sf::seconds(2)) != sf::Socket::Done) {
+		std::cerr << "proxy: failed to connect to the server\n";
+		client.disconnect();
+		return;
+	}
+
+	std::cout << "proxy: tcp client connected\n";
+	for (auto& link : links) {
+		link.chunks.clear();
+		link.chunk_sent = 0;
+		link.last_release = 0;
+	}
+	for (auto& socket : tcp_sockets) {
+		socket.setBlocking(false);
+		selector->add(socket);
+	}
+	tcp_connected = true;
+}
+
+void Proxy::CloseTcp(sf::SocketSelector* const selector)
+{
+	std::cout << "proxy: tcp client disconnected\n";
+	for (auto& socket : tcp_sockets) {
+		selector->remove(socket);
+		socket.disconnect();
+	}
+	tcp_connected = false;
+}
+
+bool Proxy::ReadTcp(const Direction direction)
+{
+	char buffer[kChunkSize];
+	for (;;) {
+		std::size_t received;
+		const auto status = tcp_sockets[direction].receive(buffer, sizeof(buffer), received);
+		if (status == sf::Socket::NotReady)
+			return true;
+		else if (status != sf::Socket::Done)
+			return false;
+		Schedule(direction, buffer, received, true);
+	}
+}
+
+bool Proxy::WriteTcp(const Direction direction)
+{
+	auto& link = links[direction];
+	auto& socket = tcp_sockets[direction == Up ? Down : Up];
+	const auto now = Now();
+	while (!link.chunks.empty() && link.chunks.front().release <= now) {
+		const auto& data = link.chunks.front().data;
+		std::size_t sent = 0;
+		const auto status = socket.send(data.data() + link.chunk_sent, data.size() - link.chunk_sent, sent);
+		if (status == sf::Socket::Disconnected || status == sf::Socket::Error)
+			return false;
+
+		link.chunk_sent += sent;
+		if (link.chunk_sent < data.size())
+			return true;
+		link.chunks.pop_front();
+		link.chunk_sent = 0;
+	}
+	return true;
+}
+
+// whatever doesn't come from the server comes from the client, the last
+// address seen is where the server's datagrams go
+void Proxy::ReadUdp()
+{
+	char buffer[sf::UdpSocket::MaxDatagramSize];
+	std::size_t received;
+	sf::IpAddress ip;
+	unsigned short port;
+	while (udp_socket.receive(buffer, sizeof(buffer), received, ip, port) == sf::Socket::Done) {
+		if (ip == sf::IpAddress::LocalHost && port == Connection::kPort) {
+			if (has_udp_client)
+				Schedule(Down, buffer, received, false);
+		} else {
+			udp_client_ip = ip;
+			udp_client_port = port;
+			has_udp_client = true;
+			Schedule(Up, buffer, received, false);
+		}
+	}
+}
+
+void Proxy::WriteUdp(const Direction direction)
+{
+	auto& datagrams = links[direction].datagrams;
+	const auto now = Now();
+	const auto due = std::stable_partition(datagrams.begin(), datagrams.end(),
+	                                       [now](const Packet& packet) { return packet.release > now; });
+	std::sort(due, datagrams.end(), [](const Packet& a, const Packet& b) { return a.release < b.release; });
+	for (auto it = due; it != datagrams.end(); ++it) {
+		if (direction == Up)
+			udp_socket.send(it->data.data(), it->data.size(), sf::IpAddress::LocalHost, Connection::kPort);
+		else
+			udp_socket.send(it->data.data(), it->data.size(), udp_client_ip, udp_client_port);
+	}
+	datagrams.erase(due, datagrams.end());
+}
+
+void Proxy::PrintStats()
+{
+	const auto index = CurrentPhase();
+	const auto& settings = phases[index].settings;
+	std::cout << "phase " << index + 1 << '/' << phases.size() << ": "
+	          << settings.latency << " ms, " << settings.jitter << " ms jitter, "
+	          << settings.loss << "% loss, " << settings.reorder << "% reorder, ";
+	if (settings.bandwidth > 0)
+		std::cout << settings.bandwidth << " kbit/s\n";
+	else
+		std::cout << "unlimited\n";
+
+	for (const auto direction : {Up, Down}) {
+		const auto& link = links[direction];
+		std::cout << (direction == Up ? "  up: " : "  down: ")
+		          << link.packets << " packets, " << link.bytes / 1024 << " KB, "
+		          << link.lost << " lost, " << link.reordered << " reordered, "
+		          << link.datagrams.size() + link.chunks.size() << " in flight\n";
+	}
+}
+
+sf::Int64 Proxy::Now()
+{
+	return clock.getElapsedTime().asMicroseconds();
+}
+
+bool Proxy::Chance(const float percent)
+{
+	std::uniform_real_distribution<float> distribution(0.f, 100.f);
+	return percent > 0 && distribution(random_engine) < percent;
+}
@@ -0,0 +1,40 @@
+#ifndef PONGON_PROXY_HPP_
+#define PONGON_PROXY_HPP_
+#include <SFML/System.hpp>
+
+// network impairment proxy for testing on one machine. it listens on
+// kPort for tcp and udp, forwards to a -server on Connection::kPort of
+// the loopback and delays, drops and reorders what goes through both
+// ways, following a profile. clients join it entering "127.0.0.1:7172"
+//
+// a profile is a built in name or a file with one phase per line:
+//   <seconds> <latency ms> <jitter ms> <loss %> <reorder %> <kbit/s>
+// phases run in order and the script starts over after the last one. a
+// phase of 0 seconds lasts forever, a bandwidth of 0 is unlimited and #
+// starts a comment. over tcp a lost chunk is held back as long as a
+// retransmission would take and nothing is reordered
+namespace Proxy {
+	constexpr const unsigned short kPort {7172};
+	// how long a reordered datagram is held back, beyond its latency
+	constexpr const float kReorderDelay {25.f};
+	// the shortest retransmission timeout a lost tcp chunk waits
+	constexpr const float kMinRetransmit {200.f};
+	constexpr const float kStatsInterval {5.f};
+
+	struct Settings {
+		float latency;
+		float jitter;
+		float loss;
+		float reorder;
+		float bandwidth;
+	};
+
+	struct Phase {
+		float duration;
+		Settings settings;
+	};
+
+	bool Run(const char* profile);
+}
+
+#endif
@@ -0,0 +1,178 @@
+#include <cstring>
+#include <iostream>
+
+#include "game.hpp"
+#include "replay.hpp"
+#include "timestep.hpp"
+#include "wire.hpp"
+
+namespace Replay {
+	Recorder recorder;
+
+	// the ball's position and velocity and where the paddles are, exactly.
+	// the frame is the replay's own and the paddle velocities are inputs
+	using PaddleSchema = Schema::Struct<
+		PONGON_FIELD(PaddleState::x, Schema::Exact),
+		PONGON_FIELD(PaddleState::y, Schema::Exact)>;
+	using SavedStateSchema = Schema::Struct<
+		PONGON_FIELD(GameState::ball, VectorSchema),
+		PONGON_FIELD(GameState::ball_velocity, VectorSchema),
+		PONGON_FIELD(GameState::local, PaddleSchema),
+		PONGON_FIELD(GameState::remote, PaddleSchema)>;
+	constexpr const std::size_t kSavedStateSize {SavedStateSchema::kMaxSize};
+	// the tick rate goes as a float
+	constexpr const std::size_t kHeaderSize {sizeof(kMagic) + 1 + 4 + kSavedStateSize};
+
+	static void WriteRun(Recorder* recorder);
+	static bool ReadState(const char* src, GameState* state);
+	// false for a rate the game can't be run at, nan included
+	static bool ReadRate(const char* src, float* rate);
+}
+
+
+bool Replay::Open(const std::string& path, const GameState& state, Recorder* const recorder)
+{
+	recorder->file.open(path, std::ios::binary | std::ios::trunc);
+	if (!recorder->file) {
+		std::cerr << "failed to open " << path << " for recording\n";
+		return false;
+	}
+
+	char header[kHeaderSize];
+	std::memcpy(header, kMagic, sizeof(kMagic));
+	header[sizeof(kMagic)] = static_cast<char>(kVersion);
+	Wire::WriteF32(tick_rate(), header + sizeof(kMagic) + 1);
+	SavedStateSchema::Encode(state, header + sizeof(kMagic) + 1 + 4);
+	recorder->file.write(header, sizeof(header));
+
+	recorder->run = 0;
+	recorder->frames = 0;
+	return static_cast<bool>(recorder->file);
+}
+
+void Replay::Record(const float local, const float remote, Recorder* const recorder)
+{
+	if (!recorder->file.is_open())
+		return;
+
+	if (recorder->run > 0 && (local != recorder->local || remote != recorder->remote || recorder->run == kMaxRun))
+		WriteRun(recorder);
+
+	recorder->local = local;
+	recorder->remote = remote;
+	++recorder->run;
+	if (++recorder->frames % kFlushInterval == 0)
+		recorder->file.flush();
+}
+
+// the inputs so far go out first, the state is for the frames after them
+void Replay::Resync(const GameState& state, Recorder* const recorder)
+{
+	if (!recorder->file.is_open())
+		return;
+
+	if (recorder->run > 0)
+		WriteRun(recorder);
+	char marker[1 + kSavedStateSize];
+	Wire::Writer writer {marker, 1, 0};
+	Wire::Write(&writer, kResyncCode, Wire::kInputBits);
+	SavedStateSchema::Encode(state, marker + 1);
+	recorder->file.write(marker, sizeof(marker));
+}
+
+void Replay::Close(Recorder* const recorder)
+{
+	if (!recorder->file.is_open())
+		return;
+
+	if (recorder->run > 0)
+		WriteRun(recorder);
+	recorder->file.close();
+}
+
+bool Replay::Play(const char* const path, const bool fast)
+{
+	std::ifstream file(path, std::ios::binary);
+	char header[kHeaderSize];
+	GameState state {};
+	float rate;
+	if (!file.read(header, sizeof(header)) || std::memcmp(header, kMagic, sizeof(kMagic)) != 0 ||
+	    static_cast<sf::Uint8>(header[sizeof(kMagic)]) != kVersion ||
+	    !ReadRate(header + sizeof(kMagic) + 1, &rate) ||
+	    !ReadState(header + sizeof(kMagic) + 1 + 4, &state)) {
+		std::cerr << "not a recording: " << path << '\n';
+		return false;
+	}
+
+	// steps are as long as the recorded ones
+	set_tick_rate(rate);
+	const auto tick = sf::seconds(1.f / rate);
+	const sf::Clock clock;
+	sf::Int64 frames = 0;
+	int resyncs = 0;
+	char record;
+	while (file.get(record)) {
+		Wire::Reader reader {&record, 1, 0, false};
+		if (Wire::Read(&reader, Wire::kInputBits) == kResyncCode) {
+			char saved[kSavedStateSize];
+			if (!file.read(saved, sizeof(saved)) || !ReadState(saved, &state)) {
+				std::cerr << "truncated resync in " << path << '\n';
+				return false;
+			}
+			++resyncs;
+			continue;
+		}
+
+		reader = {&record, 1, 0, false};
+		const auto local = Wire::ReadInput(&reader);
+		const auto remote = Wire::ReadInput(&reader);
+		const auto run = static_cast<int>(Wire::Read(&reader, 4)) + 1;
+		for (int i = 0; i < run; ++i) {
+			step({local, remote}, &state);
+			++frames;
+			if (!fast) {
+				const auto due = tick * frames;
+				const auto now = clock.getElapsedTime();
+				if (due > now)
+					sf::sleep(due - now);
+			}
+		}
+	}
+
+	const auto elapsed = clock.getElapsedTime();
+	const auto seconds = elapsed.asSeconds() > 0 ? elapsed.asSeconds() : 1e-6f;
+	std::cout << "replay: " << frames << " frames at " << rate << " Hz (" << (tick * frames).asSeconds()
+	          << " s of play), " << resyncs << " resyncs, in " << elapsed.asMilliseconds() << " ms, "
+	          << frames / seconds << " frames/s\n"
+	          << "final state: ball " << to_float(state.ball.x) << ", " << to_float(state.ball.y)
+	          << ", paddles " << to_float(state.local.y) << ", " << to_float(state.remote.y) << '\n';
+	return true;
+}
+
+void Replay::WriteRun(Recorder* const recorder)
+{
+	char record;
+	Wire::Writer writer {&record, 1, 0};
+	Wire::WriteInput(&writer, recorder->local);
+	Wire::WriteInput(&writer, recorder->remote);
+	Wire::Write(&writer, static_cast<sf::Uint32>(recorder->run - 1), 4);
+	recorder->file.put(record);
+	recorder->run = 0;
+}
+
+// the paddle velocities are zeroed, the frame is left as it is
+bool Replay::ReadState(const char* const src, GameState* const state)
+{
+	if (!SavedStateSchema::Decode(src, kSavedStateSize, state))
+		return false;
+
+	state->local.velocity = to_scalar(0.f);
+	state->remote.velocity = to_scalar(0.f);
+	return true;
+}
+
+bool Replay::ReadRate(const char* const src, float* const rate)
+{
+	*rate = Wire::ReadF32(src);
+	return *rate >= Timestep::kMinRate && *rate <= Timestep::kMaxRate;
+}
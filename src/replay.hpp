@@ -0,0 +1,51 @@
+#ifndef PONGON_REPLAY_HPP_
+#define PONGON_REPLAY_HPP_
+#include <fstream>
+#include <string>
+
+#include <SFML/System.hpp>
+
+#include "simulation.hpp"
+
+// match recordings: the tick rate and the state a match started from,
+// followed by the paddle velocities both sides simulated each frame with.
+// the file is only ever appended to, one byte per record: the local and
+// remote inputs 2 bits each, as Wire::WriteInput writes them, and 4 bits
+// of how many frames minus 1 they lasted. a local input of kResyncCode,
+// which no paddle velocity takes, marks a resync instead and is followed
+// by the whole state the match went on from. playing it runs step
+// again and ends up in the same state, except for the lockstep client
+// and -interpolate, which also move things by what the peer sent
+namespace Replay {
+	constexpr const char kMagic[4] {'P', 'O', 'N', 'G'};
+	// also bumped with Physics::kRevision, the same inputs play out
+	// differently
+	constexpr const sf::Uint8 kVersion {3};
+	constexpr const sf::Uint32 kResyncCode {3};
+	constexpr const int kMaxRun {16};
+	// frames between flushes to disk, what a crash may lose
+	constexpr const sf::Uint32 kFlushInterval {300};
+
+	struct Recorder {
+		std::ofstream file;
+		float local {0.f};
+		float remote {0.f};
+		int run {0};
+		sf::Uint32 frames {0};
+	};
+
+	// what this process' match is recorded to with -record
+	extern Recorder recorder;
+
+	// the tick rate is the one step runs at
+	bool Open(const std::string& path, const GameState& state, Recorder* recorder);
+	// these do nothing when the recorder isn't open
+	void Record(float local, float remote, Recorder* recorder);
+	// the match went on from state, the frames recorded so far stay
+	void Resync(const GameState& state, Recorder* recorder);
+	void Close(Recorder* recorder);
+	// headless, at the recorded tick rate or as fast as it runs
+	bool Play(const char* path, bool fast);
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <iostream>
+
+#include "desync.hpp"
+#include "input_queue.hpp"
+#include "replay.hpp"
+#include "rollback.hpp"
+
+namespace Rollback {
+	Stats stats;
+
+	// remote inputs arriving ahead of our frame go to the input queue, so
+	// only the states and predictions inside the window are kept here
+	constexpr const sf::Int32 kRingSize {2 * kMaxWindow};
+	constexpr const sf::Int32 kIdleInterval {10};
+	static sf::Int32 window;
+	static GameState states[kRingSize];
+	static float predicted[kRingSize];
+	static sf::Int32 frame;
+	static sf::Int32 last_idle;
+	// frames [0, recorded) went to the recording
+	static sf::Int32 recorded;
+
+	static void Resimulate(sf::Int32 from, GameState* state);
+	static float RemoteInput(sf::Int32 frame);
+}
+
+
+void Rollback::Init(const int frames)
+{
+	window = std::max(1, std::min(frames, kMaxWindow));
+	stats = Stats();
+	Restart();
+}
+
+void Rollback::Restart()
+{
+	frame = 0;
+	last_idle = 0;
+	recorded = 0;
+	InputQueue::Init();
+	Desync::Restart();
+}
+
+bool Rollback::Update(const float local_input, GameState* const state)
+{
+	const auto old_confirmed = InputQueue::confirmed;
+	if (!InputQueue::Receive())
+		return false;
+
+	// the first frame simulated with a wrong prediction is where to rewind
+	const auto last_checked = std::min(InputQueue::confirmed, frame - 1);
+	for (auto f = old_confirmed + 1; f <= last_checked; ++f) {
+		if (predicted[f % kRingSize] != InputQueue::Remote(f)) {
+			Resimulate(f, state);
+			break;
+		}
+	}
+
+	// confirmed frames are never simulated again, nor the states they
+	// start from
+	for (; recorded <= last_checked; ++recorded) {
+		Desync::Record(recorded, states[recorded % kRingSize]);
+		Replay::Record(InputQueue::Local(recorded), InputQueue::Remote(recorded), &Replay::recorder);
+	}
+
+	// past the window there is no state left to rollback to, so wait
+	// for the peer. when we are ahead of it, skip a frame now and then to
+	// let it catch up instead of always running at the window's edge
+	const auto advantage = frame - (InputQueue::confirmed + 1);
+	if (frame - InputQueue::confirmed > window || InputQueue::Full()) {
+		++stats.stalls;
+	} else if (advantage - InputQueue::remote_advantage >= 2 && frame - last_idle >= kIdleInterval) {
+		last_idle = frame;
+		++stats.idles;
+	} else {
+		states[frame % kRingSize] = *state;
+		step({local_input, RemoteInput(frame)}, state);
+		InputQueue::Push(to_float(state->local.velocity));
+		++frame;
+		++stats.frames;
+	}
+
+	return InputQueue::Send(frame - (InputQueue::confirmed + 1));
+}
+
+void Rollback::PrintStats()
+{
+	std::cout << "rollback: " << stats.frames << " frames, "
+	          << stats.rollbacks << " rollbacks, "
+	          << stats.resimulated << " frames resimulated, "
+	          << stats.stalls << " stalls, "
+	          << stats.idles << " idles\n";
+}
+
+void Rollback::Resimulate(const sf::Int32 from, GameState* const state)
+{
+	++stats.rollbacks;
+	*state = states[from % kRingSize];
+	for (auto f = from; f < frame; ++f) {
+		states[f % kRingSize] = *state;
+		step({InputQueue::Local(f), RemoteInput(f)}, state);
+		++stats.resimulated;
+	}
+}
+
+// the remote paddle is predicted to keep the last confirmed velocity.
+// the prediction is stored to be checked against the real input later
+float Rollback::RemoteInput(const sf::Int32 input_frame)
+{
+	if (input_frame <= InputQueue::confirmed)
+		return InputQueue::Remote(input_frame);
+
+	auto& prediction = predicted[input_frame % kRingSize];
+	prediction = InputQueue::confirmed < 0 ? 0.f : InputQueue::Remote(InputQueue::confirmed);
+	return prediction;
+}
@@ -0,0 +1,32 @@
+#ifndef PONGON_ROLLBACK_HPP_
+#define PONGON_ROLLBACK_HPP_
+#include <SFML/System.hpp>
+
+#include "simulation.hpp"
+
+// the remote paddle input is predicted so the simulation never waits for
+// the network. when the real input arrives and differs from the one
+// predicted, the game state is restored to that frame and simulated again
+// up to the present. both peers must run with the same window
+namespace Rollback {
+	constexpr const int kMaxWindow {16};
+	constexpr const int kDefaultWindow {8};
+
+	struct Stats {
+		sf::Uint32 frames;
+		sf::Uint32 rollbacks;
+		sf::Uint32 resimulated;
+		sf::Uint32 stalls;
+		sf::Uint32 idles;
+	};
+
+	extern Stats stats;
+
+	void Init(int window);
+	// goes back to frame 0 from the current state, after a resync
+	void Restart();
+	bool Update(float local_input, GameState* state);
+	void PrintStats();
+}
+
+#endif
@@ -0,0 +1,276 @@
+#ifndef PONGON_SCHEMA_HPP_
+#define PONGON_SCHEMA_HPP_
+#include <cstddef>
+#include <cstring>
+
+#include <SFML/System.hpp>
+
+#include "simulation.hpp"
+#include "wire.hpp"
+
+// messages declared once as a list of fields, each a member and the codec
+// it goes on the wire with:
+//
+//   using PaddleSchema = Schema::Struct<
+//   	PONGON_FIELD(PaddleSample::time, Schema::Unsigned<Wire::kFrameBits>),
+//   	PONGON_FIELD(PaddleSample::y, Schema::Fixed<Schema::PositionScale>)>;
+//
+// writing and reading are the Wire calls one would write by hand, in the
+// fields' order, resolved at compile time. kBits is the size and kTag
+// changes with the layout: every field's codec, its width and whatever
+// else decides how its bits are read, like a scale, so peers can tell
+// they agree on it. array
+// members take one value per element, and a Struct is a codec too, for
+// the members that are structs themselves
+#define PONGON_FIELD(member, ...) ::Schema::Field<decltype(&member), &member, __VA_ARGS__>
+
+namespace Schema {
+	// fnv-1a over the values, in order
+	template<std::size_t N>
+	constexpr sf::Uint32 Tag(const sf::Uint32 (&values)[N])
+	{
+		sf::Uint32 tag {2166136261u};
+		for (const auto value : values)
+			tag = (tag ^ value) * 16777619u;
+		return tag;
+	}
+
+	// tells codecs of the same width apart in a tag
+	enum CodecId : sf::Uint32 {kUnsigned = 1, kSigned, kFixed, kInput, kExact, kStruct};
+
+	// a float parameter of a codec in a tag, to 1/65536
+	constexpr sf::Uint32 Parameter(const float value)
+	{
+		return static_cast<sf::Uint32>(static_cast<sf::Int32>(value * 65536.f));
+	}
+
+	// what the float codecs read goes into a float or a FixedPoint member
+	constexpr void Assign(const float value, float* const member)
+	{
+		*member = value;
+	}
+
+	template<int FracBits>
+	constexpr void Assign(const float value, FixedPoint<FracBits>* const member)
+	{
+		*member = FixedPoint<FracBits>::FromFloat(value);
+	}
+
+	template<int Bits>
+	struct Unsigned {
+		static constexpr int kBits {Bits};
+		static constexpr sf::Uint32 kTag {Tag({kUnsigned, Bits})};
+
+		template<class Value>
+		static void Write(Wire::Writer* const writer, const Value& value)
+		{
+			Wire::Write(writer, static_cast<sf::Uint32>(value), Bits);
+		}
+
+		template<class Value>
+		static void Read(Wire::Reader* const reader, Value* const value)
+		{
+			*value = static_cast<Value>(Wire::Read(reader, Bits));
+		}
+	};
+
+	template<int Bits>
+	struct Signed {
+		static constexpr int kBits {Bits};
+		static constexpr sf::Uint32 kTag {Tag({kSigned, Bits})};
+
+		template<class Value>
+		static void Write(Wire::Writer* const writer, const Value& value)
+		{
+			Wire::WriteSigned(writer, static_cast<sf::Int32>(value), Bits);
+		}
+
+		template<class Value>
+		static void Read(Wire::Reader* const reader, Value* const value)
+		{
+			*value = static_cast<Value>(Wire::ReadSigned(reader, Bits));
+		}
+	};
+
+	struct PositionScale {
+		static constexpr float kScale {Wire::kPositionScale};
+	};
+
+	struct VelocityScale {
+		static constexpr float kScale {Wire::kVelocityScale};
+	};
+
+	// a float or a Scalar in Wire::kValueBits of fixed point
+	template<class Scale>
+	struct Fixed {
+		static constexpr int kBits {Wire::kValueBits};
+		static constexpr sf::Uint32 kTag {Tag({kFixed, kBits, Parameter(Scale::kScale)})};
+
+		template<class Value>
+		static void Write(Wire::Writer* const writer, const Value& value)
+		{
+			Wire::WriteSigned(writer, Wire::Quantize(to_float(value), Scale::kScale), kBits);
+		}
+
+		template<class Value>
+		static void Read(Wire::Reader* const reader, Value* const value)
+		{
+			Assign(Wire::Dequantize(Wire::ReadSigned(reader, kBits), Scale::kScale), value);
+		}
+	};
+
+	// a paddle velocity, see Wire::WriteInput
+	struct Input {
+		static constexpr int kBits {Wire::kInputBits};
+		static constexpr sf::Uint32 kTag {Tag({kInput, kBits, Parameter(kPaddleVelocity)})};
+
+		static void Write(Wire::Writer* const writer, const float value)
+		{
+			Wire::WriteInput(writer, value);
+		}
+
+		static void Read(Wire::Reader* const reader, float* const value)
+		{
+			*value = Wire::ReadInput(reader);
+		}
+	};
+
+	// a float's bits as they are, or a FixedPoint's count, which fits
+	// 32 bits for anything on the screen
+	struct Exact {
+		static constexpr int kBits {32};
+		static constexpr sf::Uint32 kTag {Tag({kExact, kBits})};
+
+		static void Write(Wire::Writer* const writer, const float value)
+		{
+			sf::Uint32 bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			Wire::Write(writer, bits, kBits);
+		}
+
+		template<int FracBits>
+		static void Write(Wire::Writer* const writer, const FixedPoint<FracBits> value)
+		{
+			Wire::Write(writer, static_cast<sf::Uint32>(value.Raw()), kBits);
+		}
+
+		static void Read(Wire::Reader* const reader, float* const value)
+		{
+			const auto bits = Wire::Read(reader, kBits);
+			std::memcpy(value, &bits, sizeof(*value));
+		}
+
+		template<int FracBits>
+		static void Read(Wire::Reader* const reader, FixedPoint<FracBits>* const value)
+		{
+			*value = FixedPoint<FracBits>::FromRaw(static_cast<sf::Int32>(Wire::Read(reader, kBits)));
+		}
+	};
+
+	// how many values of its codec a member takes
+	template<class Value>
+	struct Elements {
+		static constexpr int kCount {1};
+
+		template<class Codec>
+		static void Write(Wire::Writer* const writer, const Value& value)
+		{
+			Codec::Write(writer, value);
+		}
+
+		template<class Codec>
+		static void Read(Wire::Reader* const reader, Value* const value)
+		{
+			Codec::Read(reader, value);
+		}
+	};
+
+	template<class T, std::size_t N>
+	struct Elements<T[N]> {
+		static constexpr int kCount {static_cast<int>(N) * Elements<T>::kCount};
+
+		template<class Codec>
+		static void Write(Wire::Writer* const writer, const T (&value)[N])
+		{
+			for (const auto& element : value)
+				Elements<T>::template Write<Codec>(writer, element);
+		}
+
+		template<class Codec>
+		static void Read(Wire::Reader* const reader, T (* const value)[N])
+		{
+			for (auto& element : *value)
+				Elements<T>::template Read<Codec>(reader, &element);
+		}
+	};
+
+	template<class MemberPointer, MemberPointer member, class Codec>
+	struct Field;
+
+	template<class T, class Value, Value T::*member, class Codec>
+	struct Field<Value T::*, member, Codec> {
+		static constexpr int kBits {Elements<Value>::kCount * Codec::kBits};
+		static constexpr sf::Uint32 kTag {Tag({static_cast<sf::Uint32>(Elements<Value>::kCount), Codec::kTag})};
+
+		static void Write(Wire::Writer* const writer, const T& value)
+		{
+			Elements<Value>::template Write<Codec>(writer, value.*member);
+		}
+
+		static void Read(Wire::Reader* const reader, T* const value)
+		{
+			Elements<Value>::template Read<Codec>(reader, &(value->*member));
+		}
+	};
+
+	template<std::size_t N>
+	constexpr int Sum(const int (&bits)[N])
+	{
+		int sum {0};
+		for (const auto field : bits)
+			sum += field;
+		return sum;
+	}
+
+	template<class ...Fields>
+	struct Struct {
+		// the leading values keep the arrays valid without fields
+		static constexpr int kBits {Sum({0, Fields::kBits...})};
+		static constexpr std::size_t kMaxSize {(kBits + 7) / 8};
+		static constexpr sf::Uint32 kTag {Tag({kStruct, Fields::kTag...})};
+
+		template<class T>
+		static void Write(Wire::Writer* const writer, const T& value)
+		{
+			const int expand[] {0, (Fields::Write(writer, value), 0)...};
+			static_cast<void>(expand);
+		}
+
+		template<class T>
+		static void Read(Wire::Reader* const reader, T* const value)
+		{
+			const int expand[] {0, (Fields::Read(reader, value), 0)...};
+			static_cast<void>(expand);
+		}
+
+		// a whole payload, dest holds kMaxSize. returns the bytes written
+		template<class T>
+		static std::size_t Encode(const T& value, char* const dest)
+		{
+			Wire::Writer writer {dest, kMaxSize, 0};
+			Write(&writer, value);
+			return Wire::Size(writer);
+		}
+
+		// false unless src is exactly one
+		template<class T>
+		static bool Decode(const char* const src, const std::size_t size, T* const value)
+		{
+			Wire::Reader reader {src, size, 0, false};
+			Read(&reader, value);
+			return !reader.overflow && size == kMaxSize;
+		}
+	};
+}
+
+#endif
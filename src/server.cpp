@@ -0,0 +1,776 @@
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "allocations.hpp"
+#include "connection.hpp"
+#include "game.hpp"
+#include "lockstep.hpp"
+#include "poller.hpp"
+#include "protocol.hpp"
+#include "replay.hpp"
+#include "server.hpp"
+#include "spectator.hpp"
+#include "wire.hpp"
+
+namespace Server {
+	struct Match;
+
+	// greeting: its nickname not yet received, queued: waiting for an
+	// opponent, or for the one holding the same lobby ticket
+	enum class State {Greeting, Queued, Playing, Closed};
+
+	constexpr const std::size_t kRxSize {4 * (Connection::kFrameHeaderSize + Connection::kMaxMessageSize)};
+	// a client letting this much pile up unread is dropped
+	constexpr const std::size_t kTxSize {16 * 1024};
+	constexpr const std::size_t kMaxNickPacketSize {64};
+	// chat lines waiting to go out to a client, the oldest one is dropped
+	// when it is full
+	constexpr const std::size_t kChatBacklog {8};
+
+	struct Client {
+		Poller::Socket socket;
+		State state {State::Greeting};
+		std::string nick;
+		// the session token it greeted with, a lobby ticket when not 0
+		sf::Uint32 ticket {0};
+		// since it got to its state
+		sf::Clock clock;
+		Match* match {nullptr};
+		int side {0};
+		float velocity {0.f};
+		// tick messages sent so far, which is the client's frame number
+		sf::Int32 frame {0};
+		Lockstep::Peer peer;
+		sf::Uint8 chat_id {0};
+		sf::Uint8 chat_received {0};
+		Connection::ChatLine chat_out[kChatBacklog];
+		std::size_t chat_first {0};
+		std::size_t chat_count {0};
+		std::size_t rx_size {0};
+		std::size_t tx_size {0};
+		char rx[kRxSize];
+		char tx[kTxSize];
+	};
+
+	// a message written once and sent as it is to every spectator that
+	// queued it, back to the pool once none of them holds it
+	struct Broadcast {
+		int refs;
+		Spectator::Kind kind;
+		std::size_t size;
+		char data[Connection::kFrameHeaderSize + Spectator::kMaxMessageSize];
+	};
+
+	// spectators only ever get written to, a closed one shows up when a
+	// send fails. interval: it gets the frames multiple of it
+	struct Viewer {
+		Poller::Socket socket;
+		Match* match {nullptr};
+		Broadcast* queue[kSpectatorBacklog];
+		std::size_t first {0};
+		std::size_t count {0};
+		// bytes of the first one already sent
+		std::size_t sent {0};
+		int interval {1};
+		sf::Clock progress_clock;
+		bool closed {false};
+	};
+
+	static_assert(kSpectatorBacklog >= 2, "the partly sent frame must not be the one replaced");
+
+	// simulated from the left player's side. every client draws itself on
+	// the right, so the left player gets the ball mirrored. the match
+	// holds a reference on its info and newest state broadcasts
+	struct Match {
+		Client* players[2];
+		GameState game;
+		sf::Int32 frame {0};
+		bool closed {false};
+		int viewers {0};
+		Broadcast* info {nullptr};
+		Broadcast* state {nullptr};
+		Replay::Recorder recorder;
+	};
+
+	struct Stats {
+		sf::Uint64 ticks;
+		sf::Uint64 overruns;
+		sf::Uint64 dropped;
+		sf::Uint64 bytes_sent;
+		sf::Uint64 spectator_bytes;
+		sf::Uint64 skipped;
+		sf::Uint64 spectators_dropped;
+		sf::Time busy;
+	};
+
+	static Poller::Listener listener;
+	static std::vector<std::unique_ptr<Client>> clients;
+	static std::vector<std::unique_ptr<Match>> matches;
+	static std::unique_ptr<Client> spare;
+	static Client* queued;
+	static std::unordered_map<sf::Uint32, Client*> tickets;
+	static const char* record_dir;
+	static sf::Uint64 match_count;
+	static Poller::Listener spectator_listener;
+	static std::vector<std::unique_ptr<Viewer>> viewers;
+	static std::unique_ptr<Viewer> spare_viewer;
+	static std::vector<std::unique_ptr<Broadcast>> broadcasts;
+	static std::vector<Broadcast*> free_broadcasts;
+	static Stats stats;
+	static Poller::Set poller;
+
+	static void Poll(sf::Time timeout);
+	static void Accept();
+	static void Queue(Client* client);
+	static void Pair(Client* first, Client* second);
+	static void Read(Client* client);
+	static bool Parse(Client* client);
+	static void HandlePing(Client* client, const char* data, std::size_t size);
+	static bool HandleMessage(Client* client, const char* message, std::size_t size);
+	static void Tick();
+	static void SendTick(Client* client);
+	static void Flush();
+	static void Expire();
+	static void Close(Client* client);
+	static void QueueChat(const Connection::ChatLine& line, Client* client);
+	static void AcceptViewers();
+	static void Attach(Viewer* viewer, Match* match);
+	static void Publish(Match* match);
+	static void FanOut();
+	static void Enqueue(Viewer* viewer, Broadcast* broadcast);
+	static void FlushViewers();
+	static void CloseViewer(Viewer* viewer);
+	static void Reserve(std::size_t count);
+	static Broadcast* Acquire();
+	static void Release(Broadcast* broadcast);
+	static void Sweep();
+	static void PrintStats(sf::Time elapsed);
+}
+
+
+bool Server::Run(const char* const directory)
+{
+	record_dir = directory;
+	set_tick_rate(kTickRate);
+	if (listener.listen(Connection::kPort) != sf::Socket::Done) {
+		std::cerr << "failed to listen port " << Connection::kPort << '\n';
+		return false;
+	} else if (spectator_listener.listen(kSpectatorPort) != sf::Socket::Done) {
+		std::cerr << "failed to listen port " << kSpectatorPort << '\n';
+		return false;
+	}
+
+	listener.setBlocking(false);
+	spectator_listener.setBlocking(false);
+	if (!Poller::Init(&poller) || !Poller::Watch(&listener, &listener, &poller) ||
+	    !Poller::Watch(&spectator_listener, &spectator_listener, &poller)) {
+		std::cerr << "failed to initialize the socket poller\n";
+		return false;
+	}
+
+	// the one a match's newest state takes before the previous is released
+	Reserve(1);
+	std::cout << "dedicated server listening on port " << Connection::kPort
+	          << ", spectators on port " << kSpectatorPort << '\n';
+
+	const auto tick = sf::seconds(1.f / kTickRate);
+	const sf::Clock clock;
+	sf::Clock stats_clock;
+	sf::Clock expire_clock;
+	auto next_tick = tick;
+	for (;;) {
+		const auto now = clock.getElapsedTime();
+		Poll(next_tick > now ? next_tick - now : sf::Time::Zero);
+
+		const sf::Clock busy_clock;
+		for (int ticks = 0; clock.getElapsedTime() >= next_tick; ++ticks) {
+			// too far behind, the missed ticks are dropped
+			if (ticks == kMaxCatchUpTicks) {
+				const auto missed = static_cast<sf::Int64>((clock.getElapsedTime() - next_tick) / tick) + 1;
+				next_tick += sf::microseconds(missed * tick.asMicroseconds());
+				stats.overruns += missed;
+				break;
+			}
+			// what a tick needs was set aside as clients and spectators came
+			const auto allocations = Allocations::Count();
+			Tick();
+			Allocations::AssertNone(allocations);
+			next_tick += tick;
+		}
+
+		// the players' sockets go first, spectators never hold them back
+		Flush();
+		FlushViewers();
+		if (expire_clock.getElapsedTime().asSeconds() >= 1.f) {
+			expire_clock.restart();
+			Expire();
+		}
+		Sweep();
+		stats.busy += busy_clock.getElapsedTime();
+
+		if (stats_clock.getElapsedTime().asSeconds() >= kStatsInterval)
+			PrintStats(stats_clock.restart());
+	}
+}
+
+void Server::Poll(const sf::Time timeout)
+{
+	void* ready[Poller::kMaxReady];
+	const auto count = Poller::Wait(timeout, &poller, ready);
+	for (int i = 0; i < count; ++i) {
+		if (ready[i] == &listener) {
+			Accept();
+		} else if (ready[i] == &spectator_listener) {
+			AcceptViewers();
+		} else {
+			auto* const client = static_cast<Client*>(ready[i]);
+			if (client->state != State::Closed)
+				Read(client);
+		}
+	}
+}
+
+void Server::Accept()
+{
+	for (;;) {
+		if (!spare)
+			spare.reset(new Client);
+		if (listener.accept(spare->socket) != sf::Socket::Done)
+			return;
+
+		auto* const client = spare.get();
+		client->socket.setBlocking(false);
+		client->clock.restart();
+		Lockstep::InitPeer(true, &client->peer);
+		// a client the poller can't wake for is dropped, spare stays for the next
+		if (!Poller::Watch(&client->socket, client, &poller)) {
+			std::cerr << "failed to watch a client socket\n";
+			client->socket.disconnect();
+			continue;
+		}
+		clients.push_back(std::move(spare));
+	}
+}
+
+// clients sent by the lobby are paired by their ticket, the others in the
+// order they come
+void Server::Queue(Client* const client)
+{
+	client->state = State::Queued;
+	client->clock.restart();
+	if (client->ticket == 0) {
+		if (queued == nullptr) {
+			queued = client;
+		} else {
+			Pair(queued, client);
+			queued = nullptr;
+		}
+		return;
+	}
+
+	const auto it = tickets.find(client->ticket);
+	if (it == tickets.end()) {
+		tickets.emplace(client->ticket, client);
+	} else {
+		auto* const first = it->second;
+		tickets.erase(it);
+		Pair(first, client);
+	}
+}
+
+// the client waits for our greeting after sending its own, like it would
+// from a -server peer, so it only gets it once it has an opponent
+void Server::Pair(Client* const first, Client* const second)
+{
+	static const std::string greeting {"PongOn"};
+	std::unique_ptr<Match> match(new Match);
+	match->game = initial_state(true);
+	match->players[0] = first;
+	match->players[1] = second;
+
+	for (int side = 0; side < 2; ++side) {
+		auto* const client = match->players[side];
+		client->match = match.get();
+		client->side = side;
+		client->state = State::Playing;
+
+		// same layout as sf::Packet with a string in it
+		auto* const dest = client->tx + client->tx_size;
+		Wire::WriteU32(static_cast<sf::Uint32>(4 + greeting.size()), dest);
+		Wire::WriteU32(static_cast<sf::Uint32>(greeting.size()), dest + 4);
+		std::memcpy(dest + 8, greeting.data(), greeting.size());
+		client->tx_size += 8 + greeting.size();
+
+		const auto& other = match->players[1 - side]->nick;
+		Connection::ChatLine line {0, {}};
+		Connection::AppendChat("PongOn:> playing against ", 25, &line);
+		Connection::AppendChat(other.data(), other.size(), &line);
+		QueueChat(line, client);
+	}
+
+	if (record_dir != nullptr) {
+		const auto path = std::string(record_dir) + "/match-" + std::to_string(++match_count) + ".pongrec";
+		Replay::Open(path, match->game, &match->recorder);
+	}
+
+	// its info and newest state
+	Reserve(2);
+	matches.push_back(std::move(match));
+}
+
+void Server::Read(Client* const client)
+{
+	for (;;) {
+		std::size_t received;
+		const auto status = client->socket.receive(client->rx + client->rx_size,
+		                                           kRxSize - client->rx_size, received);
+		if (status == sf::Socket::NotReady)
+			return;
+
+		client->rx_size += received;
+		if (status != sf::Socket::Done || !Parse(client)) {
+			Close(client);
+			return;
+		}
+	}
+}
+
+bool Server::Parse(Client* const client)
+{
+	const auto* const bytes = reinterpret_cast<const unsigned char*>(client->rx);
+	std::size_t offset = 0;
+
+	if (client->state == State::Greeting) {
+		if (client->rx_size < 8)
+			return true;
+
+		// the nick, the session token and the protocol tag
+		const auto packet_size = Wire::ReadU32(client->rx);
+		const auto nick_size = Wire::ReadU32(client->rx + 4);
+		if (packet_size > kMaxNickPacketSize || nick_size > packet_size || nick_size + 12 > packet_size)
+			return false;
+		if (client->rx_size < 4 + packet_size)
+			return true;
+		if (Wire::ReadU32(client->rx + 12 + nick_size) != Protocol::Tag(tick_rate()))
+			return false;
+
+		client->nick.assign(client->rx + 8, std::min<std::size_t>(nick_size, 10));
+		client->ticket = Wire::ReadU32(client->rx + 8 + nick_size);
+		client->rx_size -= 4 + packet_size;
+		std::memmove(client->rx, client->rx + 4 + packet_size, client->rx_size);
+		Queue(client);
+	}
+
+	// nothing else is expected before it is greeted back
+	if (client->state == State::Queued)
+		return client->rx_size < kRxSize;
+
+	while (client->rx_size - offset >= Connection::kFrameHeaderSize) {
+		const std::size_t header = (std::size_t(bytes[offset]) << 8) | bytes[offset + 1];
+		const auto size = header & ~std::size_t(Connection::kControlFrame);
+		const auto* const message = client->rx + offset + Connection::kFrameHeaderSize;
+		if (size > Connection::kMaxMessageSize)
+			return false;
+		if (client->rx_size - offset < Connection::kFrameHeaderSize + size)
+			break;
+		if (header & Connection::kControlFrame)
+			HandlePing(client, message, size);
+		else if (!HandleMessage(client, message, size))
+			return false;
+		offset += Connection::kFrameHeaderSize + size;
+	}
+
+	client->rx_size -= offset;
+	std::memmove(client->rx, client->rx + offset, client->rx_size);
+	return true;
+}
+
+// clients ping us like they would a peer, only pongs are sent back
+void Server::HandlePing(Client* const client, const char* const data, const std::size_t size)
+{
+	constexpr const auto kFrameSize = Connection::kFrameHeaderSize + Connection::kPongSize;
+	if (size != Connection::kPingSize || data[0] != Connection::kPing || client->tx_size + kFrameSize > kTxSize)
+		return;
+
+	auto* const dest = client->tx + client->tx_size;
+	dest[0] = static_cast<char>((Connection::kControlFrame | Connection::kPongSize) >> 8);
+	dest[1] = static_cast<char>(Connection::kPongSize);
+	client->tx_size += Connection::kFrameHeaderSize + Connection::WritePong(data, dest + Connection::kFrameHeaderSize);
+}
+
+bool Server::HandleMessage(Client* const client, const char* const message, const std::size_t size)
+{
+	const std::size_t chat_size = static_cast<unsigned char>(message[2]);
+	if (size < Connection::kChatHeaderSize + chat_size)
+		return false;
+
+	// chat lines are relayed to the opponent as they are
+	const auto chat_id = static_cast<sf::Uint8>(message[0]);
+	if (chat_size > 0 && chat_id != client->chat_received) {
+		client->chat_received = chat_id;
+		Connection::ChatLine line {0, {}};
+		Connection::AppendChat(message + Connection::kChatHeaderSize, chat_size, &line);
+		QueueChat(line, client->match->players[1 - client->side]);
+	}
+
+	Lockstep::Message decoded;
+	if (Lockstep::Decode(message + Connection::kChatHeaderSize + chat_size,
+	                     size - Connection::kChatHeaderSize - chat_size,
+	                     client->frame, &client->peer, &decoded)) {
+		client->velocity = decoded.velocity;
+	}
+	return true;
+}
+
+void Server::Tick()
+{
+	++stats.ticks;
+	for (auto& match : matches) {
+		if (match->closed)
+			continue;
+
+		// the velocities are the ones the clients sent for the last frame
+		if (match->frame > 0) {
+			Replay::Record(match->players[0]->velocity, match->players[1]->velocity, &match->recorder);
+			step({match->players[0]->velocity, match->players[1]->velocity}, &match->game);
+		}
+
+		++match->frame;
+		SendTick(match->players[0]);
+		SendTick(match->players[1]);
+		if (match->viewers > 0)
+			Publish(match.get());
+	}
+
+	FanOut();
+}
+
+void Server::SendTick(Client* const client)
+{
+	if (client->state == State::Closed)
+		return;
+
+	if (client->tx_size + Connection::kFrameHeaderSize + Connection::kMaxMessageSize > kTxSize) {
+		++stats.dropped;
+		Close(client);
+		return;
+	}
+
+	const auto* const match = client->match;
+	const auto* const opponent = match->players[1 - client->side];
+	Lockstep::Message message {};
+	message.velocity = opponent->velocity;
+	if (client->frame % Lockstep::kSnapshotInterval == 0) {
+		auto& snapshot = message.snapshot;
+		snapshot = {client->frame, match->game.ball, match->game.ball_velocity};
+		if (client->side == 0) {
+			snapshot.position.x = to_scalar(kWinWidth) - snapshot.position.x;
+			snapshot.velocity.x = -snapshot.velocity.x;
+		}
+		message.flags |= Lockstep::kHasSnapshot;
+	}
+
+	char payload[Lockstep::kMaxPayloadSize];
+	const auto size = Lockstep::Encode(message, &client->peer, payload);
+
+	// tcp delivers the line, it is sent only once
+	const char* chat = nullptr;
+	std::size_t chat_size = 0;
+	if (client->chat_count > 0) {
+		const auto& line = client->chat_out[client->chat_first];
+		chat = line.text;
+		chat_size = line.size;
+		client->chat_first = (client->chat_first + 1) % kChatBacklog;
+		--client->chat_count;
+		++client->chat_id;
+	}
+
+	client->tx_size += Connection::WriteMessage(client->chat_id, client->chat_received,
+	                                            chat, chat_size, payload, size,
+	                                            client->tx + client->tx_size);
+	++client->frame;
+}
+
+void Server::Flush()
+{
+	for (auto& client : clients) {
+		if (client->state == State::Closed || client->tx_size == 0)
+			continue;
+
+		std::size_t sent = 0;
+		const auto status = client->socket.send(client->tx, client->tx_size, sent);
+		if (status == sf::Socket::Disconnected || status == sf::Socket::Error) {
+			Close(client.get());
+			continue;
+		}
+
+		stats.bytes_sent += sent;
+		client->tx_size -= sent;
+		std::memmove(client->tx, client->tx + sent, client->tx_size);
+	}
+}
+
+// a client that never greets, or whose ticket's other holder doesn't
+// show up, is let go
+void Server::Expire()
+{
+	for (auto& client : clients) {
+		const auto waited = client->clock.getElapsedTime().asSeconds();
+		if ((client->state == State::Greeting && waited > kGreetingTimeout) ||
+		    (client->state == State::Queued && client->ticket != 0 && waited > kTicketTimeout))
+			Close(client.get());
+	}
+}
+
+// a match ends with either player leaving, the other is let go as well
+void Server::Close(Client* const client)
+{
+	if (client->state == State::Closed)
+		return;
+
+	if (client->state == State::Queued) {
+		const auto it = tickets.find(client->ticket);
+		if (it != tickets.end() && it->second == client)
+			tickets.erase(it);
+		if (queued == client)
+			queued = nullptr;
+	}
+	client->state = State::Closed;
+	Poller::Unwatch(&client->socket, &poller);
+	client->socket.disconnect();
+
+	if (client->match != nullptr) {
+		client->match->closed = true;
+		Close(client->match->players[1 - client->side]);
+	}
+}
+
+void Server::QueueChat(const Connection::ChatLine& line, Client* const client)
+{
+	if (client->chat_count == kChatBacklog) {
+		client->chat_first = (client->chat_first + 1) % kChatBacklog;
+		--client->chat_count;
+	}
+	client->chat_out[(client->chat_first + client->chat_count) % kChatBacklog] = line;
+	++client->chat_count;
+}
+
+void Server::AcceptViewers()
+{
+	for (;;) {
+		if (!spare_viewer)
+			spare_viewer.reset(new Viewer);
+		if (spectator_listener.accept(spare_viewer->socket) != sf::Socket::Done)
+			return;
+
+		spare_viewer->socket.setBlocking(false);
+		viewers.push_back(std::move(spare_viewer));
+		Reserve(kSpectatorBacklog);
+	}
+}
+
+void Server::Attach(Viewer* const viewer, Match* const match)
+{
+	if (match->info == nullptr) {
+		match->info = Acquire();
+		match->info->kind = Spectator::kInfo;
+		match->info->size = Spectator::WriteInfo(match->players[0]->nick, match->players[1]->nick,
+		                                         match->info->data);
+	}
+
+	viewer->match = match;
+	++match->viewers;
+	Enqueue(viewer, match->info);
+}
+
+// the frame is written once, whatever the number of spectators
+void Server::Publish(Match* const match)
+{
+	Spectator::State state;
+	state.frame = match->frame;
+	state.ball = match->game.ball;
+	state.ball_velocity = match->game.ball_velocity;
+	state.paddles[0] = match->game.local.y;
+	state.paddles[1] = match->game.remote.y;
+
+	auto* const broadcast = Acquire();
+	broadcast->kind = Spectator::kState;
+	broadcast->size = Spectator::WriteState(state, broadcast->data);
+	if (match->state != nullptr)
+		Release(match->state);
+	match->state = broadcast;
+}
+
+// a spectator without a match gets the oldest one running
+void Server::FanOut()
+{
+	for (auto& viewer : viewers) {
+		if (viewer->closed) {
+			continue;
+		} else if (viewer->match == nullptr) {
+			const auto it = std::find_if(matches.begin(), matches.end(), [](const std::unique_ptr<Match>& match) {
+				return !match->closed;
+			});
+			if (it != matches.end())
+				Attach(viewer.get(), it->get());
+		} else if (!viewer->match->closed && viewer->match->state != nullptr &&
+		           viewer->match->frame % viewer->interval == 0) {
+			Enqueue(viewer.get(), viewer->match->state);
+		}
+	}
+}
+
+// with the backlog full the spectator isn't keeping up: the newest frame
+// waiting is replaced, so what it gets is still current, and it is sent
+// fewer of them
+void Server::Enqueue(Viewer* const viewer, Broadcast* const broadcast)
+{
+	if (viewer->count == kSpectatorBacklog) {
+		viewer->interval = std::min(viewer->interval * 2, kMaxSpectatorInterval);
+		++stats.skipped;
+		auto& last = viewer->queue[(viewer->first + viewer->count - 1) % kSpectatorBacklog];
+		if (last->kind != Spectator::kState)
+			return;
+		Release(last);
+		last = broadcast;
+	} else {
+		viewer->queue[(viewer->first + viewer->count) % kSpectatorBacklog] = broadcast;
+		++viewer->count;
+	}
+	++broadcast->refs;
+}
+
+void Server::FlushViewers()
+{
+	for (auto& viewer : viewers) {
+		if (viewer->closed)
+			continue;
+
+		while (viewer->count > 0) {
+			auto* const broadcast = viewer->queue[viewer->first];
+			std::size_t sent = 0;
+			const auto status = viewer->socket.send(broadcast->data + viewer->sent,
+			                                        broadcast->size - viewer->sent, sent);
+			if (status == sf::Socket::Disconnected || status == sf::Socket::Error) {
+				CloseViewer(viewer.get());
+				break;
+			}
+
+			stats.spectator_bytes += sent;
+			viewer->sent += sent;
+			if (sent > 0)
+				viewer->progress_clock.restart();
+			if (viewer->sent < broadcast->size)
+				break;
+
+			Release(broadcast);
+			viewer->sent = 0;
+			viewer->first = (viewer->first + 1) % kSpectatorBacklog;
+			// caught up, it can take frames more often again
+			if (--viewer->count == 0)
+				viewer->interval = std::max(1, viewer->interval / 2);
+		}
+
+		if (viewer->count == 0) {
+			viewer->progress_clock.restart();
+		} else if (!viewer->closed && viewer->progress_clock.getElapsedTime().asSeconds() > kSpectatorTimeout) {
+			++stats.spectators_dropped;
+			CloseViewer(viewer.get());
+		}
+	}
+}
+
+void Server::CloseViewer(Viewer* const viewer)
+{
+	viewer->closed = true;
+	viewer->socket.disconnect();
+	for (; viewer->count > 0; --viewer->count) {
+		Release(viewer->queue[viewer->first]);
+		viewer->first = (viewer->first + 1) % kSpectatorBacklog;
+	}
+	if (viewer->match != nullptr) {
+		--viewer->match->viewers;
+		viewer->match = nullptr;
+	}
+}
+
+// broadcasts are pooled. the pool grows by what each new match and
+// spectator can hold at most, so Acquire never has to during a tick
+void Server::Reserve(const std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+		broadcasts.emplace_back(new Broadcast);
+	free_broadcasts.reserve(broadcasts.size());
+	for (auto it = broadcasts.end() - static_cast<std::ptrdiff_t>(count); it != broadcasts.end(); ++it)
+		free_broadcasts.push_back(it->get());
+}
+
+Server::Broadcast* Server::Acquire()
+{
+	if (free_broadcasts.empty()) {
+		broadcasts.emplace_back(new Broadcast);
+		free_broadcasts.push_back(broadcasts.back().get());
+	}
+
+	auto* const broadcast = free_broadcasts.back();
+	free_broadcasts.pop_back();
+	broadcast->refs = 1;
+	return broadcast;
+}
+
+void Server::Release(Broadcast* const broadcast)
+{
+	if (--broadcast->refs == 0)
+		free_broadcasts.push_back(broadcast);
+}
+
+// the spectators of a match that ended wait for the next one
+void Server::Sweep()
+{
+	for (auto& viewer : viewers) {
+		if (viewer->match != nullptr && viewer->match->closed)
+			viewer->match = nullptr;
+	}
+	for (auto& match : matches) {
+		if (!match->closed)
+			continue;
+		Replay::Close(&match->recorder);
+		if (match->info != nullptr)
+			Release(match->info);
+		if (match->state != nullptr)
+			Release(match->state);
+		match->info = match->state = nullptr;
+	}
+
+	viewers.erase(std::remove_if(viewers.begin(), viewers.end(),
+	                             [](const std::unique_ptr<Viewer>& viewer) { return viewer->closed; }),
+	              viewers.end());
+	matches.erase(std::remove_if(matches.begin(), matches.end(),
+	                             [](const std::unique_ptr<Match>& match) { return match->closed; }),
+	              matches.end());
+	clients.erase(std::remove_if(clients.begin(), clients.end(),
+	                             [](const std::unique_ptr<Client>& client) { return client->state == State::Closed; }),
+	              clients.end());
+}
+
+void Server::PrintStats(const sf::Time elapsed)
+{
+	const auto ticks = stats.ticks > 0 ? stats.ticks : 1;
+	std::cout << "clients: " << clients.size()
+	          << ", matches: " << matches.size()
+	          << ", ticks: " << stats.ticks
+	          << ", busy: " << stats.busy.asSeconds() * 1000.f / ticks << " ms/tick"
+	          << " (" << 100.f * stats.busy.asSeconds() / elapsed.asSeconds() << "%)"
+	          << ", sent: " << stats.bytes_sent / elapsed.asSeconds() / 1024.f << " KB/s"
+	          << ", overruns: " << stats.overruns
+	          << ", dropped: " << stats.dropped
+	          << ", spectators: " << viewers.size()
+	          << " (" << stats.spectator_bytes / elapsed.asSeconds() / 1024.f << " KB/s"
+	          << ", " << stats.skipped << " skipped, " << stats.spectators_dropped << " dropped)\n";
+	stats = Stats();
+}
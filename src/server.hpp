@@ -0,0 +1,33 @@
+#ifndef PONGON_SERVER_HPP_
+#define PONGON_SERVER_HPP_
+#include <cstddef>
+
+// headless match server. it keeps accepting clients on Connection::kPort,
+// pairs them into matches and steps every match on a fixed tick, owning
+// the ball and relaying paddles and chat. clients join it as they would
+// join a -server peer, over tcp with the default lockstep netcode. the
+// ones a Lobby sends greet with its ticket as their session token and are
+// paired with the other holder of it.
+// every socket goes through one readiness loop, epoll on linux.
+// spectators connecting on kSpectatorPort are attached to a running match
+// and get its frames, each serialized once and shared by all of them
+namespace Server {
+	constexpr const float kTickRate {60.f};
+	constexpr const int kMaxCatchUpTicks {4};
+	constexpr const float kGreetingTimeout {10.f};
+	// how long a client with a lobby ticket waits for the other one
+	constexpr const float kTicketTimeout {10.f};
+	constexpr const float kStatsInterval {10.f};
+	constexpr const unsigned short kSpectatorPort {7173};
+	// frames queued for a spectator at most. one that falls behind is sent
+	// every second tick, then every fourth, up to kMaxSpectatorInterval,
+	// and is dropped once it took nothing for kSpectatorTimeout seconds
+	constexpr const std::size_t kSpectatorBacklog {8};
+	constexpr const int kMaxSpectatorInterval {8};
+	constexpr const float kSpectatorTimeout {5.f};
+
+	// with record_dir, every match is recorded there, see Replay
+	bool Run(const char* record_dir);
+}
+
+#endif
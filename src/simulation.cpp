@@ -0,0 +1,59 @@
+#include "physics.hpp"
+#include "simulation.hpp"
+
+static float rate {kBaseTickRate};
+
+GameState initial_state(const bool local_on_left)
+{
+	constexpr const auto middle = kWinHeight / 2.f;
+	constexpr const auto left = kPaddleWidth / 2.f;
+	constexpr const auto right = kWinWidth - kPaddleWidth / 2.f;
+
+	GameState state {};
+	state.ball = {to_scalar(kWinWidth / 2.f), to_scalar(middle)};
+	state.ball_velocity = {to_scalar(kBallVelocity), to_scalar(kBallVelocity / 4)};
+	state.local = {to_scalar(local_on_left ? left : right), to_scalar(middle), to_scalar(0.f)};
+	state.remote = {to_scalar(local_on_left ? right : left), to_scalar(middle), to_scalar(0.f)};
+	return state;
+}
+
+void step(const Inputs& inputs, GameState* const state)
+{
+	auto& s = *state;
+	Physics::State<Scalar> physics {
+		s.ball.x, s.ball.y,
+		s.ball_velocity.x, s.ball_velocity.y,
+		s.local.x, s.local.y, to_scalar(inputs.local),
+		s.remote.x, s.remote.y, to_scalar(inputs.remote)
+	};
+
+	Physics::Step(to_scalar(tick_length()), &physics);
+
+	s.ball = {physics.ball_x, physics.ball_y};
+	s.ball_velocity = {physics.ball_velocity_x, physics.ball_velocity_y};
+	s.local.y = physics.local_y;
+	s.local.velocity = physics.local_velocity;
+	s.remote.y = physics.remote_y;
+	s.remote.velocity = physics.remote_velocity;
+	++s.frame;
+}
+
+float clamp_velocity(const PaddleState& paddle, const float velocity)
+{
+	return to_float(Physics::Clamp(paddle.y, to_scalar(velocity)));
+}
+
+void set_tick_rate(const float ticks_per_second)
+{
+	rate = ticks_per_second;
+}
+
+float tick_rate()
+{
+	return rate;
+}
+
+float tick_length()
+{
+	return kBaseTickRate / rate;
+}
@@ -0,0 +1,97 @@
+#ifndef PONGON_SIMULATION_HPP_
+#define PONGON_SIMULATION_HPP_
+#include <cstdint>
+
+#include "fixed_point.hpp"
+
+// the game as plain data and the function advancing it a frame. nothing
+// here draws or needs a window: a GameState is a few dozen bytes, copied
+// to save a frame, sent whole to resync and stepped by the dedicated
+// server, and the window only reads it to place its shapes. its numbers
+// are the ones step does its math in, FixedPoint when built with
+// PONGON_FIXED_POINT_, so they only become floats to be drawn or sent
+
+constexpr const unsigned int kWinWidth {512};
+constexpr const unsigned int kWinHeight {256};
+
+constexpr const float kBallRadius {10.5f};
+constexpr const float kBallVelocity {2.5f};
+
+constexpr const float kPaddleWidth {15.f};
+constexpr const float kPaddleHeight {60.f};
+constexpr const float kPaddleVelocity {8.8f};
+
+// the speeds are in pixels per tick at this rate, a step at any other
+// rate moves everything as far as that part of a base tick would
+constexpr const float kBaseTickRate {60.f};
+
+#ifdef PONGON_FIXED_POINT_
+// 13 bits of fraction keep twice the screen within a float's mantissa, so
+// a position is drawn exactly where it is
+using Scalar = FixedPoint<13>;
+static_assert((std::int64_t(kWinWidth) * 2) << Scalar::kFracBits < (std::int64_t(1) << 24),
+              "positions must convert to float exactly");
+#else
+using Scalar = float;
+#endif
+
+constexpr float to_float(const float value)
+{
+	return value;
+}
+
+template<int FracBits>
+constexpr float to_float(const FixedPoint<FracBits> value)
+{
+	return value.ToFloat();
+}
+
+constexpr Scalar to_scalar(const float value)
+{
+#ifdef PONGON_FIXED_POINT_
+	return Scalar::FromFloat(value);
+#else
+	return value;
+#endif
+}
+
+struct Vector {
+	Scalar x;
+	Scalar y;
+};
+
+struct PaddleState {
+	Scalar x;
+	Scalar y;
+	Scalar velocity;
+};
+
+// local is this side's paddle, the left one on the server
+struct GameState {
+	std::int32_t frame;
+	Vector ball;
+	Vector ball_velocity;
+	PaddleState local;
+	PaddleState remote;
+};
+
+// the paddle velocities a frame runs with, as they come from the keys and
+// the wire
+struct Inputs {
+	float local;
+	float remote;
+};
+
+GameState initial_state(bool local_on_left);
+// the inputs are clamped against the walls and left in the paddles
+void step(const Inputs& inputs, GameState* state);
+// what step would make of a paddle's input
+float clamp_velocity(const PaddleState& paddle, float velocity);
+// the ticks a second step runs at, kBaseTickRate until set. both peers
+// must step at the same one to stay in sync
+void set_tick_rate(float rate);
+float tick_rate();
+// a tick's length in base ticks
+float tick_length();
+
+#endif
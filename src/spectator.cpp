@@ -0,0 +1,206 @@
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include <SFML/Graphics.hpp>
+#include <SFML/Network.hpp>
+
+#include "connection.hpp"
+#include "game.hpp"
+#include "server.hpp"
+#include "spectator.hpp"
+#include "wire.hpp"
+
+namespace Spectator {
+	Stats stats;
+
+	constexpr const std::size_t kRxSize {16 * (Connection::kFrameHeaderSize + kMaxMessageSize)};
+	static_assert(1 + StateSchema::kMaxSize <= kMaxMessageSize, "a state must fit in a message");
+	static sf::TcpSocket socket;
+	static char rx[kRxSize];
+	static std::size_t rx_size;
+	// the last frame received, -1 until one of the match is
+	static sf::Int32 frame;
+	// the ball moves its velocity every base tick, between states it is
+	// moved by the time the drawn frame took, at most a few ticks so a
+	// hitch doesn't throw it across the field
+	constexpr const float kMaxExtrapolation {4.f / kBaseTickRate};
+	static sf::Clock drawn_clock;
+
+	static std::size_t WriteHeader(const Wire::Writer& writer, char* dest);
+	static bool Receive(sf::RenderWindow* window, GameState* game);
+	static bool Apply(const char* message, std::size_t size, sf::RenderWindow* window,
+	                  GameState* game);
+}
+
+
+std::size_t Spectator::WriteInfo(const std::string& left, const std::string& right, char* const dest)
+{
+	Wire::Writer writer {dest + Connection::kFrameHeaderSize, kMaxMessageSize, 0};
+	Wire::Write(&writer, kInfo, 8);
+	for (const auto* const nick : {&left, &right}) {
+		const auto size = std::min<std::size_t>(nick->size(), 10);
+		Wire::Write(&writer, static_cast<sf::Uint32>(size), 8);
+		for (std::size_t i = 0; i < size; ++i)
+			Wire::Write(&writer, static_cast<unsigned char>((*nick)[i]), 8);
+	}
+	return WriteHeader(writer, dest);
+}
+
+std::size_t Spectator::WriteState(const State& state, char* const dest)
+{
+	Wire::Writer writer {dest + Connection::kFrameHeaderSize, kMaxMessageSize, 0};
+	Wire::Write(&writer, kState, 8);
+	StateSchema::Write(&writer, state);
+	return WriteHeader(writer, dest);
+}
+
+bool Spectator::Run(const char* const address)
+{
+	std::string host {address};
+	unsigned short port {Server::kSpectatorPort};
+	const auto colon = host.find(':');
+	if (colon != std::string::npos) {
+		port = static_cast<unsigned short>(std::atoi(host.c_str() + colon + 1));
+		host.resize(colon);
+	}
+
+	if (socket.connect(host, port, sf::seconds(Connection::kDefaultTimeout)) != sf::Socket::Done) {
+		std::cerr << "failed to connect to " << host << ':' << port << '\n';
+		return false;
+	}
+
+	socket.setBlocking(false);
+	std::cout << "watching " << host << ':' << port << ", waiting for a match...\n";
+
+	auto game = initial_state(true);
+	Shapes shapes;
+	sf::RenderWindow window({kWinWidth, kWinHeight}, "PongOn");
+	sf::Event event;
+	frame = -1;
+
+	window.setFramerateLimit(60);
+	while (window.isOpen()) {
+		while (window.pollEvent(event)) {
+			if (event.type == sf::Event::Closed)
+				window.close();
+		}
+
+		if (!Receive(&window, &game)) {
+			std::cerr << "disconnected from the server\n";
+			break;
+		}
+
+		update_shapes(game, &shapes);
+		window.clear(sf::Color::Blue);
+		window.draw(shapes.ball);
+		window.draw(shapes.local);
+		window.draw(shapes.remote);
+		window.display();
+	}
+
+	socket.disconnect();
+	return true;
+}
+
+void Spectator::PrintStats()
+{
+	std::cout << "spectator: " << stats.matches << " matches, "
+	          << stats.states << " states, "
+	          << stats.skipped << " ticks skipped\n";
+}
+
+std::size_t Spectator::WriteHeader(const Wire::Writer& writer, char* const dest)
+{
+	const auto size = Wire::Size(writer);
+	dest[0] = static_cast<char>(size >> 8);
+	dest[1] = static_cast<char>(size);
+	return Connection::kFrameHeaderSize + size;
+}
+
+// when the server sent us fewer ticks than it ran, the ball keeps going
+// with its velocity until the next state
+bool Spectator::Receive(sf::RenderWindow* const window, GameState* const game)
+{
+	bool updated = false;
+	for (;;) {
+		std::size_t received;
+		const auto status = socket.receive(rx + rx_size, kRxSize - rx_size, received);
+		if (status == sf::Socket::NotReady)
+			break;
+		else if (status != sf::Socket::Done)
+			return false;
+		rx_size += received;
+
+		std::size_t offset = 0;
+		while (rx_size - offset >= Connection::kFrameHeaderSize) {
+			const auto* const bytes = reinterpret_cast<const unsigned char*>(rx + offset);
+			const std::size_t size = (std::size_t(bytes[0]) << 8) | bytes[1];
+			if (size == 0 || size > kMaxMessageSize)
+				return false;
+			if (rx_size - offset < Connection::kFrameHeaderSize + size)
+				break;
+			const auto* const message = rx + offset + Connection::kFrameHeaderSize;
+			if (!Apply(message, size, window, game))
+				return false;
+			updated = updated || message[0] == kState;
+			offset += Connection::kFrameHeaderSize + size;
+		}
+
+		rx_size -= offset;
+		std::memmove(rx, rx + offset, rx_size);
+	}
+
+	const auto elapsed = std::min(drawn_clock.restart().asSeconds(), kMaxExtrapolation);
+	if (!updated && frame >= 0) {
+		const auto ticks = to_scalar(elapsed * kBaseTickRate);
+		game->ball.x += game->ball_velocity.x * ticks;
+		game->ball.y += game->ball_velocity.y * ticks;
+	}
+	return true;
+}
+
+bool Spectator::Apply(const char* const message, const std::size_t size, sf::RenderWindow* const window,
+                      GameState* const game)
+{
+	Wire::Reader reader {message, size, 0, false};
+	const auto kind = Wire::Read(&reader, 8);
+	if (kind == kInfo) {
+		std::string nicks[2];
+		for (auto& nick : nicks) {
+			const auto nick_size = Wire::Read(&reader, 8);
+			for (sf::Uint32 i = 0; i < nick_size && !reader.overflow; ++i)
+				nick += static_cast<char>(Wire::Read(&reader, 8));
+		}
+		if (reader.overflow)
+			return false;
+
+		window->setTitle("PongOn: " + nicks[0] + " vs " + nicks[1]);
+		std::cout << "watching " << nicks[0] << " vs " << nicks[1] << '\n';
+		frame = -1;
+		++stats.matches;
+		return true;
+	} else if (kind != kState) {
+		return false;
+	}
+
+	State state;
+	StateSchema::Read(&reader, &state);
+	if (reader.overflow)
+		return false;
+
+	const auto low = static_cast<sf::Uint32>(state.frame);
+	const auto received_frame = frame < 0 ? state.frame : Wire::Expand(low, frame);
+	game->ball_velocity = state.ball_velocity;
+
+	if (frame >= 0 && received_frame > frame + 1)
+		stats.skipped += static_cast<sf::Uint32>(received_frame - frame - 1);
+	frame = received_frame;
+	++stats.states;
+	game->ball = state.ball;
+	game->local.y = state.paddles[0];
+	game->remote.y = state.paddles[1];
+	return true;
+}
@@ -0,0 +1,58 @@
+#ifndef PONGON_SPECTATOR_HPP_
+#define PONGON_SPECTATOR_HPP_
+#include <cstddef>
+#include <string>
+
+#include <SFML/System.hpp>
+
+#include "schema.hpp"
+#include "simulation.hpp"
+
+// watches the matches of a -dedicated server from its spectator port. the
+// server writes every message once and sends it as it is to each
+// spectator: a 2 byte size and a payload starting with its kind.
+// info: the left and right players' nicks, each a byte of size and the
+// characters. state: the frame 16 bits, the ball's position and velocity
+// and the paddles' y, 16 bit fixed point each
+namespace Spectator {
+	enum Kind : sf::Uint8 {kInfo, kState};
+	constexpr const std::size_t kMaxMessageSize {32};
+
+	// a match frame, as the left player sees it
+	struct State {
+		sf::Int32 frame;
+		Vector ball;
+		Vector ball_velocity;
+		Scalar paddles[2];
+	};
+
+	template<class Scale>
+	using FixedVectorSchema = Schema::Struct<
+		PONGON_FIELD(Vector::x, Schema::Fixed<Scale>),
+		PONGON_FIELD(Vector::y, Schema::Fixed<Scale>)>;
+
+	// the frame goes as its low bits
+	using StateSchema = Schema::Struct<
+		PONGON_FIELD(State::frame, Schema::Unsigned<Wire::kFrameBits>),
+		PONGON_FIELD(State::ball, FixedVectorSchema<Schema::PositionScale>),
+		PONGON_FIELD(State::ball_velocity, FixedVectorSchema<Schema::VelocityScale>),
+		PONGON_FIELD(State::paddles, Schema::Fixed<Schema::PositionScale>)>;
+
+	struct Stats {
+		sf::Uint32 states;
+		// ticks the server didn't send us, having fallen behind
+		sf::Uint32 skipped;
+		sf::Uint32 matches;
+	};
+
+	extern Stats stats;
+
+	// dest holds Connection::kFrameHeaderSize + kMaxMessageSize, both
+	// return the bytes written, the size included
+	std::size_t WriteInfo(const std::string& left, const std::string& right, char* dest);
+	std::size_t WriteState(const State& state, char* dest);
+	bool Run(const char* address);
+	void PrintStats();
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef PONGON_SPSC_QUEUE_HPP_
+#define PONGON_SPSC_QUEUE_HPP_
+#include <cstddef>
+#include <atomic>
+
+// bounded lock free queue for exactly one producer thread and one consumer
+// thread. each side only writes its own index, the other one is read with
+// acquire ordering so the item copied in before a push is visible after it.
+// the indices sit on cache lines of their own, or every push and pop would
+// take the line from the other thread. queues are meant to be static, new
+// before c++17 doesn't honor the alignment
+constexpr const std::size_t kCacheLineSize {64};
+
+template<class T, std::size_t N>
+class SpscQueue {
+	static_assert(N > 0 && (N & (N - 1)) == 0, "queue size must be a power of two");
+
+public:
+	// producer side, false when full
+	bool Push(const T& item)
+	{
+		const auto tail = tail_index.load(std::memory_order_relaxed);
+		const auto size = tail - head_index.load(std::memory_order_acquire);
+		if (size == N)
+			return false;
+
+		items[tail & (N - 1)] = item;
+		tail_index.store(tail + 1, std::memory_order_release);
+		if (size + 1 > high_water.load(std::memory_order_relaxed))
+			high_water.store(size + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// consumer side, false when empty
+	bool Pop(T* const item)
+	{
+		const auto head = head_index.load(std::memory_order_relaxed);
+		if (head == tail_index.load(std::memory_order_acquire))
+			return false;
+
+		*item = items[head & (N - 1)];
+		head_index.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Empty() const
+	{
+		return head_index.load(std::memory_order_acquire) == tail_index.load(std::memory_order_acquire);
+	}
+
+	bool Full() const
+	{
+		return tail_index.load(std::memory_order_acquire) - head_index.load(std::memory_order_acquire) == N;
+	}
+
+	// the most items it ever held at once
+	std::size_t HighWater() const
+	{
+		return high_water.load(std::memory_order_relaxed);
+	}
+
+	static constexpr std::size_t Capacity()
+	{
+		return N;
+	}
+
+private:
+	// the consumer's
+	alignas(kCacheLineSize) std::atomic<std::size_t> head_index {0};
+	// the producer's
+	alignas(kCacheLineSize) std::atomic<std::size_t> tail_index {0};
+	std::atomic<std::size_t> high_water {0};
+	alignas(kCacheLineSize) T items[N];
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include <iostream>
+
+#include "timestep.hpp"
+
+namespace Timestep {
+	Stats stats;
+
+	// microseconds, summing sf::Time as floats would drift
+	static sf::Int64 tick;
+	static sf::Int64 accumulated;
+	static float rate;
+	static sf::Clock clock;
+}
+
+
+void Timestep::Init(const float ticks_per_second)
+{
+	rate = ticks_per_second;
+	tick = static_cast<sf::Int64>(1000000.f / rate + 0.5f);
+	accumulated = 0;
+	stats = Stats();
+	clock.restart();
+}
+
+int Timestep::Due()
+{
+	accumulated += clock.restart().asMicroseconds();
+	auto due = accumulated / tick;
+	accumulated %= tick;
+	if (due > kMaxCatchUpTicks) {
+		stats.dropped += static_cast<sf::Uint32>(due - kMaxCatchUpTicks);
+		due = kMaxCatchUpTicks;
+	}
+
+	++stats.frames;
+	stats.ticks += static_cast<sf::Uint32>(due);
+	if (due == 0)
+		++stats.idle;
+	return static_cast<int>(due);
+}
+
+void Timestep::PrintStats()
+{
+	std::cout << "timestep: " << stats.ticks << " ticks at " << rate << " Hz, "
+	          << stats.frames << " frames drawn, " << stats.idle << " without a tick, "
+	          << stats.dropped << " ticks dropped\n";
+}
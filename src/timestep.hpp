@@ -0,0 +1,37 @@
+#ifndef PONGON_TIMESTEP_HPP_
+#define PONGON_TIMESTEP_HPP_
+#include <SFML/System.hpp>
+
+#include "simulation.hpp"
+
+// the game advances on a fixed tick, however often the window is drawn.
+// the time each drawn frame took is added up and spent in whole ticks,
+// the remainder carried to the next. a frame taking too long runs at most
+// kMaxCatchUpTicks and drops the rest, or a tick costing more than its
+// own length would fall further behind every frame. step scales the
+// speeds by the tick's length, so the game keeps its pace at any rate, but
+// both players must still use the same one
+namespace Timestep {
+	constexpr const float kDefaultRate {kBaseTickRate};
+	constexpr const float kMinRate {10.f};
+	constexpr const float kMaxRate {480.f};
+	constexpr const int kMaxCatchUpTicks {4};
+
+	struct Stats {
+		sf::Uint32 frames;
+		sf::Uint32 ticks;
+		sf::Uint32 dropped;
+		// drawn without a tick run before
+		sf::Uint32 idle;
+	};
+
+	extern Stats stats;
+
+	// rate in ticks a second
+	void Init(float rate);
+	// the ticks to run before drawing the next frame, called once a frame
+	int Due();
+	void PrintStats();
+}
+
+#endif
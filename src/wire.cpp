@@ -0,0 +1,150 @@
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "simulation.hpp"
+#include "wire.hpp"
+
+
+void Wire::Write(Writer* const writer, const sf::Uint32 value, const int count)
+{
+	assert(count >= 0 && count <= 32);
+	assert(writer->bits + count <= writer->capacity * 8);
+	for (int i = count - 1; i >= 0; --i) {
+		const auto byte = writer->bits / 8;
+		const auto shift = 7 - writer->bits % 8;
+		if (shift == 7)
+			writer->data[byte] = 0;
+		if ((value >> i) & 1)
+			writer->data[byte] = static_cast<char>(writer->data[byte] | (1 << shift));
+		++writer->bits;
+	}
+}
+
+sf::Uint32 Wire::Read(Reader* const reader, const int count)
+{
+	assert(count >= 0 && count <= 32);
+	sf::Uint32 value = 0;
+	for (int i = 0; i < count; ++i) {
+		const auto byte = reader->bits / 8;
+		if (byte >= reader->size) {
+			reader->overflow = true;
+			return 0;
+		}
+		const auto bit = (static_cast<unsigned char>(reader->data[byte]) >> (7 - reader->bits % 8)) & 1;
+		value = (value << 1) | bit;
+		++reader->bits;
+	}
+	return value;
+}
+
+void Wire::WriteSigned(Writer* const writer, const sf::Int32 value, const int count)
+{
+	Write(writer, static_cast<sf::Uint32>(value), count);
+}
+
+sf::Int32 Wire::ReadSigned(Reader* const reader, const int count)
+{
+	// sign extend from count bits
+	const auto value = Read(reader, count);
+	if (count < 32 && (value >> (count - 1)) & 1)
+		return static_cast<sf::Int32>(value | ~((sf::Uint32(1) << count) - 1));
+	return static_cast<sf::Int32>(value);
+}
+
+void Wire::WriteSmall(Writer* const writer, const sf::Int32 value)
+{
+	const auto zigzag = (static_cast<sf::Uint32>(value) << 1) ^ static_cast<sf::Uint32>(value >> 31);
+	if (zigzag == 0) {
+		Write(writer, 0, 1);
+		return;
+	}
+
+	int length = 0;
+	while (length < 32 && (zigzag >> length) != 0)
+		++length;
+	Write(writer, 1, 1);
+	Write(writer, static_cast<sf::Uint32>(length - 1), 5);
+	Write(writer, zigzag, length);
+}
+
+sf::Int32 Wire::ReadSmall(Reader* const reader)
+{
+	if (Read(reader, 1) == 0)
+		return 0;
+
+	const auto length = static_cast<int>(Read(reader, 5)) + 1;
+	const auto zigzag = Read(reader, length);
+	return static_cast<sf::Int32>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+}
+
+void Wire::WriteInput(Writer* const writer, const float velocity)
+{
+	Write(writer, velocity < 0 ? 1 : velocity > 0 ? 2 : 0, kInputBits);
+}
+
+float Wire::ReadInput(Reader* const reader)
+{
+	switch (Read(reader, kInputBits)) {
+	case 1: return -kPaddleVelocity;
+	case 2: return kPaddleVelocity;
+	default: return 0.f;
+	}
+}
+
+std::size_t Wire::Size(const Writer& writer)
+{
+	return (writer.bits + 7) / 8;
+}
+
+sf::Int32 Wire::Quantize(const float value, const float scale)
+{
+	constexpr const float kMax = (1 << (kValueBits - 1)) - 1;
+	return static_cast<sf::Int32>(std::max(-kMax, std::min(std::round(value * scale), kMax)));
+}
+
+float Wire::Dequantize(const sf::Int32 value, const float scale)
+{
+	return value / scale;
+}
+
+sf::Int32 Wire::Expand(const sf::Uint32 low, const sf::Int32 near)
+{
+	constexpr const sf::Uint32 kMask {(1u << kFrameBits) - 1};
+	constexpr const sf::Int32 kHalf {1 << (kFrameBits - 1)};
+	auto diff = static_cast<sf::Int32>((low - static_cast<sf::Uint32>(near)) & kMask);
+	if (diff >= kHalf)
+		diff -= 2 * kHalf;
+	return near + diff;
+}
+
+void Wire::WriteU32(const sf::Uint32 value, char* const dest)
+{
+	dest[0] = static_cast<char>(value >> 24);
+	dest[1] = static_cast<char>(value >> 16);
+	dest[2] = static_cast<char>(value >> 8);
+	dest[3] = static_cast<char>(value);
+}
+
+sf::Uint32 Wire::ReadU32(const char* const src)
+{
+	const auto* const bytes = reinterpret_cast<const unsigned char*>(src);
+	return (sf::Uint32(bytes[0]) << 24) | (sf::Uint32(bytes[1]) << 16) |
+	       (sf::Uint32(bytes[2]) << 8) | sf::Uint32(bytes[3]);
+}
+
+void Wire::WriteF32(const float value, char* const dest)
+{
+	sf::Uint32 bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	WriteU32(bits, dest);
+}
+
+float Wire::ReadF32(const char* const src)
+{
+	const auto bits = ReadU32(src);
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
@@ -0,0 +1,62 @@
+#ifndef PONGON_WIRE_HPP_
+#define PONGON_WIRE_HPP_
+#include <cstddef>
+
+#include <SFML/System.hpp>
+
+// the wire encoding: values are packed most significant bit first into
+// bytes, so the result doesn't depend on the host byte order, and floats
+// go as fixed point integers of only as many bits as they need
+namespace Wire {
+	// fixed point scales: 1/32 pixel for positions, 1/256 pixel per
+	// frame for velocities. both go in 16 bits signed
+	constexpr const float kPositionScale {32.f};
+	constexpr const float kVelocityScale {256.f};
+	constexpr const int kValueBits {16};
+	// frame numbers and times go as their low bits
+	constexpr const int kFrameBits {16};
+	constexpr const int kInputBits {2};
+	// bits a WriteSmall takes at most
+	constexpr const int kMaxSmallBits {1 + 5 + 32};
+
+	struct Writer {
+		char* data;
+		std::size_t capacity;
+		std::size_t bits;
+	};
+
+	// reading past the end gives zeros and sets overflow
+	struct Reader {
+		const char* data;
+		std::size_t size;
+		std::size_t bits;
+		bool overflow;
+	};
+
+	void Write(Writer* writer, sf::Uint32 value, int count);
+	sf::Uint32 Read(Reader* reader, int count);
+	void WriteSigned(Writer* writer, sf::Int32 value, int count);
+	sf::Int32 ReadSigned(Reader* reader, int count);
+	// a zero bit for 0, else a one bit, 5 bits of length and the value
+	// zigzag encoded. meant for deltas, which are mostly small
+	void WriteSmall(Writer* writer, sf::Int32 value);
+	sf::Int32 ReadSmall(Reader* reader);
+	// paddle velocities only ever are -kPaddleVelocity, 0 or kPaddleVelocity
+	void WriteInput(Writer* writer, float velocity);
+	float ReadInput(Reader* reader);
+	// bytes taken so far, the last one padded with zeros
+	std::size_t Size(const Writer& writer);
+
+	sf::Int32 Quantize(float value, float scale);
+	float Dequantize(sf::Int32 value, float scale);
+	// the value whose low kFrameBits are low closest to near
+	sf::Int32 Expand(sf::Uint32 low, sf::Int32 near);
+
+	void WriteU32(sf::Uint32 value, char* dest);
+	sf::Uint32 ReadU32(const char* src);
+	// the float's bits as they are, for when the exact value matters
+	void WriteF32(float value, char* dest);
+	float ReadF32(const char* src);
+}
+
+#endif